@@ -2,6 +2,10 @@
 #include <argparse/argparse.hpp>
 #include "kde.hpp"
 
+#ifdef KDE_APP_USE_MKL_RNG
+#include <oneapi/mkl/rng.hpp>
+#endif
+
 #include <vector>
 #include <string>
 #include <iostream>
@@ -10,6 +14,11 @@
 #include <memory>
 #include <exception>
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <utility>
 
 std::string get_device_info(const sycl::device &d) {
     std::stringstream ss{};
@@ -40,16 +49,258 @@ std::vector<T> uniform_random_vector(Engine &eng, T a, T b, const size_t n)
     return vec;
 }
 
+static const auto &dist_uniform = "uniform";
+static const auto &dist_normal = "normal";
+static const auto &dist_mixture = "mixture";
+
+/* Parameters of sample distributions. Normal distribution is centered
+ * in the unit cuboid; mixture of Gaussians has equally likely components
+ * with centers drawn uniformly from [mixture_lo, mixture_hi]^dim
+ */
+constexpr double normal_scale = 0.125;
+constexpr std::int32_t n_mixture_components = 4;
+constexpr double mixture_scale = 0.05;
+constexpr double mixture_lo = 0.2;
+constexpr double mixture_hi = 0.8;
+
+/* Draw `n` points of dimension `n_dims` from distribution `dist_name` on host.
+ * For the mixture, `centers` is content of (n_mixture_components, n_dims) array
+ */
+template <typename T, typename Engine>
+std::vector<T> host_random_sample(
+    Engine &eng,
+    const std::string &dist_name,
+    const std::vector<T> &centers,
+    const size_t n,
+    const size_t n_dims)
+{
+    if (dist_name == dist_normal) {
+        std::vector<T> vec{};
+        vec.reserve(n * n_dims);
+
+        std::normal_distribution<T> normal_dist(T(0.5), T(normal_scale));
+        for(size_t i = 0; i < n * n_dims; ++i) {
+            vec.emplace_back(normal_dist(eng));
+        }
+
+        return vec;
+    } else if (dist_name == dist_mixture) {
+        std::vector<T> vec{};
+        vec.reserve(n * n_dims);
+
+        std::uniform_int_distribution<std::int32_t> component_dist(0, n_mixture_components - 1);
+        std::normal_distribution<T> normal_dist(T(0), T(mixture_scale));
+        for(size_t i = 0; i < n; ++i) {
+            const T *center = centers.data() + component_dist(eng) * n_dims;
+            for(size_t k = 0; k < n_dims; ++k) {
+                vec.emplace_back(center[k] + normal_dist(eng));
+            }
+        }
+
+        return vec;
+    } else {
+        return uniform_random_vector(eng, T(0), T(1), n * n_dims);
+    }
+}
+
+#ifdef KDE_APP_USE_MKL_RNG
+template <typename T>
+class mixture_shift_krn;
+
+/* Generate `n` points of dimension `n_dims` from distribution `dist_name`
+ * directly into USM allocation `sample_usm` using oneMKL device RNG engine.
+ * `component_usm` is a temporary of `n` elements used by the mixture.
+ */
+template <typename T, typename EngineT>
+sycl::event device_random_sample(
+    sycl::queue &q,
+    EngineT &engine,
+    const std::string &dist_name,
+    const T *centers_usm,
+    std::int32_t *component_usm,
+    const size_t n,
+    const size_t n_dims,
+    T *sample_usm,
+    const std::vector<sycl::event> &depends)
+{
+    namespace rng = oneapi::mkl::rng;
+
+    if (dist_name == dist_normal) {
+        return rng::generate(
+            rng::gaussian<T>(T(0.5), T(normal_scale)), engine, n * n_dims, sample_usm, depends);
+    } else if (dist_name == dist_mixture) {
+        sycl::event offsets_ev = rng::generate(
+            rng::gaussian<T>(T(0), T(mixture_scale)), engine, n * n_dims, sample_usm, depends);
+        // generation tasks share the state of the engine, hence are ordered
+        sycl::event component_ev = rng::generate(
+            rng::uniform<std::int32_t>(0, n_mixture_components), engine, n, component_usm, {offsets_ev});
+
+        return q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(component_ev);
+            cgh.parallel_for<mixture_shift_krn<T>>(
+                sycl::range<2>(n, n_dims),
+                [=](sycl::id<2> id) {
+                    const size_t i = id[0];
+                    const size_t k = id[1];
+                    sample_usm[i * n_dims + k] += centers_usm[component_usm[i] * n_dims + k];
+                }
+            );
+        });
+    } else {
+        return rng::generate(
+            rng::uniform<T>(T(0), T(1)), engine, n * n_dims, sample_usm, depends);
+    }
+}
+
+/* Populate the sample and the points of interest on device, using independent
+ * engines seeded with `seed` and `seed + 1` so that both generations may
+ * execute concurrently. Returns events of populating the sample and the
+ * points of interest.
+ */
+template <typename T, typename EngineT>
+std::pair<sycl::event, sycl::event> device_random_inputs(
+    sycl::queue &q,
+    std::uint64_t seed,
+    const std::string &dist_name,
+    const T *centers_usm,
+    size_t n_sample,
+    size_t n_dims,
+    T *sample_usm,
+    size_t n_est,
+    T *poi_usm,
+    T margin,
+    const std::vector<sycl::event> &depends)
+{
+    namespace rng = oneapi::mkl::rng;
+
+    auto sample_engine = std::make_shared<EngineT>(q, seed);
+    auto poi_engine = std::make_shared<EngineT>(q, seed + 1);
+
+    std::int32_t *component_usm =
+        (dist_name == dist_mixture) ? sycl::malloc_device<std::int32_t>(n_sample, q) : nullptr;
+
+    sycl::event sample_ev = device_random_sample<T>(
+        q, *sample_engine, dist_name, centers_usm, component_usm, n_sample, n_dims, sample_usm, depends);
+
+    sycl::event poi_ev = rng::generate(
+        rng::uniform<T>(margin, T(1) - margin), *poi_engine, n_est * n_dims, poi_usm);
+
+    // engines and temporaries are released once generation completes
+    q.submit([&](sycl::handler &cgh) {
+        cgh.depends_on({sample_ev, poi_ev});
+        const sycl::context &ctx = q.get_context();
+        cgh.host_task([ctx, component_usm, sample_engine, poi_engine]() {
+            if (component_usm) {
+                sycl::free(component_usm, ctx);
+            }
+        });
+    });
+
+    return std::make_pair(sample_ev, poi_ev);
+}
+#endif
+
+/* Select smoothing parameter maximizing leave-one-out log-likelihood of the sample
+ * over geometric grid of `n_h` candidates in [h0/4, 4*h0]
+ */
+template <typename T>
+T select_bandwidth(
+    sycl::queue &q,
+    size_t n_sample,
+    size_t n_dims,
+    const T *sample_usm,
+    T h0,
+    const std::vector<sycl::event> &depends)
+{
+    constexpr size_t n_h = 16;
+
+    std::vector<T> h_grid(n_h);
+    for(size_t i = 0; i < n_h; ++i) {
+        h_grid[i] = (h0 / 4) * std::pow(T(16), T(i) / T(n_h - 1));
+    }
+
+    T *h_grid_usm = sycl::malloc_device<T>(2 * n_h, q);
+    T *ll_usm = h_grid_usm + n_h;
+
+    sycl::event h_grid_copy_ev = q.copy<T>(h_grid.data(), h_grid_usm, n_h);
+
+    std::vector<sycl::event> ll_depends(depends);
+    ll_depends.push_back(h_grid_copy_ev);
+
+    sycl::event ll_ev =
+        example::leave_one_out_log_likelihood<T>(
+            q, n_sample, n_dims, sample_usm, n_h, h_grid_usm, ll_usm, ll_depends);
+
+    std::vector<T> ll(n_h);
+    q.copy<T>(ll_usm, ll.data(), n_h, {ll_ev}).wait();
+
+    sycl::free(h_grid_usm, q);
+
+    std::cout << "Leave-one-out log-likelihood:";
+    for(size_t i = 0; i < n_h; ++i) {
+        std::cout << " " << h_grid[i] << ":" << ll[i];
+    }
+    std::cout << std::endl;
+
+    const size_t best_id = std::distance(ll.begin(), std::max_element(ll.begin(), ll.end()));
+
+    return h_grid[best_id];
+}
+
 static const auto &algo_temps = "temps";
 static const auto &algo_atomic = "atomic_ref";
 static const auto &algo_wgreduce_and_atomic = "work_group_reduce_and_atomic_ref";
 
+static const auto &kernel_gaussian = "gaussian";
+static const auto &kernel_epanechnikov = "epanechnikov";
+static const auto &kernel_tricube = "tricube";
+static const auto &kernel_uniform = "uniform";
+
+static const auto &rng_host = "host";
+static const auto &rng_philox = "philox";
+static const auto &rng_mrg32k3a = "mrg32k3a";
+
 static const auto &n_sample_opt = "--n_sample";
 static const auto &dimension_opt = "--dimension";
 static const auto &points_opt = "--points";
 static const auto &seed_opt = "--seed";
 static const auto &kde_scale_opt = "--smoothing_scale";
 static const auto &algo_opt = "--algorithm";
+static const auto &auto_bandwidth_opt = "--auto-bandwidth";
+static const auto &kernel_opt = "--kernel";
+static const auto &distribution_opt = "--distribution";
+static const auto &rng_opt = "--rng";
+static const auto &profile_opt = "--profile";
+
+// function pointer type selects unweighted overloads of implementations
+template <typename T>
+using impl_fn_t = sycl::event (*)(sycl::queue &, size_t, std::int32_t, const T*, T*, size_t, const T*, T, const std::vector<sycl::event> &);
+
+template <typename T, typename KernelT>
+impl_fn_t<T> get_impl_fn(const std::string &algo_name)
+{
+    if (algo_name == algo_temps) {
+        return example::kernel_density_estimate_temps<T, KernelT>;
+    } else if (algo_name == algo_atomic) {
+        return example::kernel_density_estimate_atomic_ref<T, KernelT>;
+    } else {
+        return example::kernel_density_estimate_work_group_reduce_and_atomic_ref<T, KernelT>;
+    }
+}
+
+template <typename T>
+impl_fn_t<T> get_impl_fn(const std::string &algo_name, const std::string &kernel_name)
+{
+    if (kernel_name == kernel_epanechnikov) {
+        return get_impl_fn<T, example::epanechnikov_kernel>(algo_name);
+    } else if (kernel_name == kernel_tricube) {
+        return get_impl_fn<T, example::tricube_kernel>(algo_name);
+    } else if (kernel_name == kernel_uniform) {
+        return get_impl_fn<T, example::uniform_kernel>(algo_name);
+    } else {
+        return get_impl_fn<T, example::gaussian_kernel>(algo_name);
+    }
+}
 
 void parse_args(argparse::ArgumentParser &program, int argc, const char *argv[]) {
     program.add_argument("-n", n_sample_opt)
@@ -86,6 +337,47 @@ void parse_args(argparse::ArgumentParser &program, int argc, const char *argv[])
         .default_value(std::string(algo_wgreduce_and_atomic))
         .choices(algo_temps, algo_atomic, algo_wgreduce_and_atomic);
 
+    program.add_argument(kernel_opt)
+        .help(std::string("Kernel function to use. Supported choices are [") +
+            kernel_gaussian + ", " +
+            kernel_epanechnikov + ", " +
+            kernel_tricube + ", " +
+            kernel_uniform +
+        "]")
+        .default_value(std::string(kernel_gaussian))
+        .choices(kernel_gaussian, kernel_epanechnikov, kernel_tricube, kernel_uniform);
+
+    program.add_argument(auto_bandwidth_opt)
+        .help("Select smoothing scale maximizing leave-one-out log-likelihood of the sample, "
+              "over a grid around the default, or given, smoothing scale")
+        .default_value(false)
+        .implicit_value(true);
+
+    program.add_argument(distribution_opt)
+        .help(std::string("Distribution of the sample. Supported choices are [") +
+            dist_uniform + ", " +
+            dist_normal + ", " +
+            dist_mixture +
+        "]")
+        .default_value(std::string(dist_uniform))
+        .choices(dist_uniform, dist_normal, dist_mixture);
+
+    program.add_argument(rng_opt)
+        .help(std::string("Where to generate the sample and the points of interest: on host, "
+            "or on device with oneMKL RNG engine. Supported choices are [") +
+            rng_host + ", " +
+            rng_philox + ", " +
+            rng_mrg32k3a +
+        "]")
+        .default_value(std::string(rng_host))
+        .choices(rng_host, rng_philox, rng_mrg32k3a);
+
+    program.add_argument(profile_opt)
+        .help("Enable profiling of the queue, and report host time of phases, device time, "
+              "allocations, transfers and kernel launches of KDE calls")
+        .default_value(false)
+        .implicit_value(true);
+
     try {
         program.parse_args(argc, argv);
     }
@@ -96,14 +388,48 @@ void parse_args(argparse::ArgumentParser &program, int argc, const char *argv[])
     }
 }
 
-int main(int argc, const char *argv[]) {
-    sycl::queue q{sycl::default_selector_v};
+/* Print telemetry counters of calls recorded since telemetry was enabled */
+void print_telemetry()
+{
+    namespace telemetry = example::telemetry;
+
+    for(const auto &[name, s] : telemetry::snapshot()) {
+        std::cout << "Profile of " << name << ": calls: " << s.n_calls
+                  << ", kernel launches: " << s.n_kernel_launches
+                  << ", allocations: " << s.n_allocations << " (" << s.bytes_allocated << " bytes)"
+                  << ", transfers: " << s.n_transfers << " (" << s.bytes_transferred << " bytes)"
+                  << std::endl;
+
+        std::cout << "  host time, us:";
+        for(size_t p = 0; p < telemetry::n_phases; ++p) {
+            std::cout << " " << telemetry::phase_name(static_cast<telemetry::phase>(p))
+                      << ": " << s.host_ns[p] / 1000.0;
+        }
+        std::cout << std::endl;
 
-    std::cout << get_device_info(q.get_device());
+        std::cout << "  device time, us: " << s.device_ns / 1000.0
+                  << " in " << s.n_device_events << " commands, spanning "
+                  << (s.device_end_ns - s.device_start_ns) / 1000.0 << std::endl;
+    }
+}
 
+int main(int argc, const char *argv[]) {
     argparse::ArgumentParser program("kde_app", "1.0");
     parse_args(program, argc, argv);
 
+    const bool profile = program.get<bool>(profile_opt);
+
+    // device execution times of commands are only recorded by queues with profiling enabled
+    sycl::queue q = (profile) ?
+        sycl::queue{sycl::default_selector_v, sycl::property::queue::enable_profiling{}} :
+        sycl::queue{sycl::default_selector_v};
+
+    std::cout << get_device_info(q.get_device());
+
+    if (profile) {
+        example::telemetry::enable();
+    }
+
     using T = float;
 
     /* Estimate density from `n_sample` points uniformly sampled
@@ -115,58 +441,98 @@ int main(int argc, const char *argv[]) {
     /* Estimate density at `points` sample points inside the cuboid */
     const size_t n_est = program.get<size_t>(points_opt);;
 
-    std::unique_ptr<std::default_random_engine> rng_uptr;
+    std::uint64_t seed;
     if (program.is_used(seed_opt)) {
-        rng_uptr = std::make_unique<std::default_random_engine>(program.get<size_t>(seed_opt));
+        seed = program.get<size_t>(seed_opt);
     } else {
         std::random_device dev;
-        rng_uptr = std::make_unique<std::default_random_engine>(dev());
+        seed = dev();
     }
 
-    std::default_random_engine rng = *rng_uptr;
-    const auto &sample = uniform_random_vector(rng, T(0), T(1), n_sample * n_dims);
+    const auto &dist_name = program.get<std::string>(distribution_opt);
+    const auto &rng_name = program.get<std::string>(rng_opt);
+
+    std::default_random_engine rng(seed);
+    // centers of mixture components are few, and are always drawn on host,
+    // with a separate engine to keep the stream of `rng` independent of them
+    std::default_random_engine centers_rng(seed + 1);
+    const auto &centers = uniform_random_vector(
+        centers_rng, T(mixture_lo), T(mixture_hi), n_mixture_components * n_dims);
 
     const T &margin = T(1)/T(10);
-    const auto &poi = uniform_random_vector(rng, margin, T(1) -  margin, n_est * n_dims);
 
     // allocated Unified Shared Memory accessible from kernels for random samples
-    T *sample_usm = sycl::malloc_device<T>(sample.size(), q);
-    // start copying data from host-allocated vector to USM allocation
-    // The event represents execution status of this task
-    sycl::event sample_copy_ev = q.copy<T>(sample.data(), sample_usm, sample.size());
-
+    T *sample_usm = sycl::malloc_device<T>(n_sample * n_dims, q);
     // USM allocation for points where PDF value needs to be estimated
-    T *poi_usm = sycl::malloc_device<T>(poi.size(), q);
-    sycl::event poi_copy_ev = q.copy<T>(poi.data(), poi_usm, poi.size());
+    T *poi_usm = sycl::malloc_device<T>(n_est * n_dims, q);
+
+    // host vectors must outlive copies from them
+    std::vector<T> sample{};
+    std::vector<T> poi{};
+    T *centers_usm = nullptr;
+
+    // events representing execution status of populating USM allocations
+    sycl::event sample_ev;
+    sycl::event poi_ev;
+
+    if (rng_name == rng_host) {
+        sample = host_random_sample<T>(rng, dist_name, centers, n_sample, n_dims);
+        poi = uniform_random_vector(rng, margin, T(1) -  margin, n_est * n_dims);
+
+        // start copying data from host-allocated vector to USM allocation
+        sample_ev = q.copy<T>(sample.data(), sample_usm, sample.size());
+        poi_ev = q.copy<T>(poi.data(), poi_usm, poi.size());
+    } else {
+#ifdef KDE_APP_USE_MKL_RNG
+        centers_usm = sycl::malloc_device<T>(centers.size(), q);
+        sycl::event centers_copy_ev = q.copy<T>(centers.data(), centers_usm, centers.size());
+
+        // generation is asynchronous, and overlaps with remaining setup on host
+        if (rng_name == rng_philox) {
+            std::tie(sample_ev, poi_ev) = device_random_inputs<T, oneapi::mkl::rng::philox4x32x10>(
+                q, seed, dist_name, centers_usm, n_sample, n_dims, sample_usm, n_est, poi_usm, margin, {centers_copy_ev});
+        } else {
+            std::tie(sample_ev, poi_ev) = device_random_inputs<T, oneapi::mkl::rng::mrg32k3a>(
+                q, seed, dist_name, centers_usm, n_sample, n_dims, sample_usm, n_est, poi_usm, margin, {centers_copy_ev});
+        }
+#else
+        std::cerr << "Option " << rng_opt << "=" << rng_name
+                  << " requires kde_app built with oneMKL RNG support" << std::endl;
+        sycl::free(poi_usm, q);
+        sycl::free(sample_usm, q);
+        std::exit(1);
+#endif
+    }
 
     // KDE smoothing parameter
-    const T &h = (program.is_used(kde_scale_opt)) ?
+    T h = (program.is_used(kde_scale_opt)) ?
         program.get<T>(kde_scale_opt) :
         (margin / 4) * std::sqrt(T(n_dims));
 
     std::cout << "KDE estimation, n_sample: " << n_sample << ", dim = " << n_dims << ", n_est = " << n_est << std::endl;
-    std::cout << "Samples are from " << n_dims << "-dimensional uniform distribution" << std::endl;
+    std::cout << "Samples are from " << n_dims << "-dimensional " << dist_name << " distribution" << std::endl;
+    if (rng_name != rng_host) {
+        std::cout << "Inputs are generated on device with oneMKL " << rng_name << " engine" << std::endl;
+    }
 
-    std::cout << "KDE smoothing parameter: " << h << std::endl;
+    if (program.get<bool>(auto_bandwidth_opt)) {
+        h = select_bandwidth<T>(q, n_sample, n_dims, sample_usm, h, {sample_ev});
+    }
 
-    using impl_fn_t = std::function<sycl::event(sycl::queue &, size_t, size_t, const T*, T*, size_t, T*, T, const std::vector<sycl::event> &)>;
-    impl_fn_t impl_fn = example::kernel_density_estimate<T>;
+    std::cout << "KDE smoothing parameter: " << h << std::endl;
 
+    const auto &algo_name = program.get<std::string>(algo_opt);
     if (program.is_used(algo_opt)) {
-        const auto &algo_name = program.get<std::string>(algo_opt);
-        if (algo_name == algo_temps) {
-            std::cout << "Using kernel implementation '" << algo_temps << "'" << std::endl;
-            impl_fn = example::kernel_density_estimate_temps<T>;
-        } else if (algo_name == algo_atomic) {
-            std::cout << "Using kernel implementation '" << algo_atomic << "'" << std::endl;
-            impl_fn = example::kernel_density_estimate_atomic_ref<T>;
-        } else {
-            std::cout << "Using kernel implementation '" << algo_wgreduce_and_atomic << "'" << std::endl;
-        }
+        std::cout << "Using kernel implementation '" << algo_name << "'" << std::endl;
     } else {
         std::cout << "Using default kernel implementation '" << algo_wgreduce_and_atomic << "'" << std::endl;
     }
 
+    const auto &kernel_name = program.get<std::string>(kernel_opt);
+    std::cout << "Using " << kernel_name << " kernel function" << std::endl;
+
+    impl_fn_t<T> impl_fn = get_impl_fn<T>(algo_name, kernel_name);
+
     // USM for estimated density function values
     T *pdf_usm = sycl::malloc_device<T>(n_est, q);
 
@@ -183,7 +549,7 @@ int main(int argc, const char *argv[]) {
             h,
             // KDE estimation kernel should begin execution
             // only after tasks of populating USM allocations complete
-            {sample_copy_ev, poi_copy_ev}
+            {sample_ev, poi_ev}
         );
 
     // container to copy the density estimateds into
@@ -191,11 +557,16 @@ int main(int argc, const char *argv[]) {
 
     // copy back and synchronize
     q.copy<T>(pdf_usm, f.data(), n_est, {kde_ev}).wait();
+    // wait for remaining tasks, such as release of device RNG engines
+    q.wait();
 
     // Free device allocations
     sycl::free(pdf_usm, q);
     sycl::free(poi_usm, q);
     sycl::free(sample_usm, q);
+    if (centers_usm) {
+        sycl::free(centers_usm, q);
+    }
 
     // Output estimated values
     std::cout << "Estimated density:";
@@ -204,5 +575,9 @@ int main(int argc, const char *argv[]) {
     }
     std::cout << std::endl;
 
+    if (profile) {
+        print_telemetry();
+    }
+
     return 0;
 }
\ No newline at end of file
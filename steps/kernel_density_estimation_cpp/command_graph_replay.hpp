@@ -0,0 +1,140 @@
+// Copyright 2022-2024 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// A copy is kept in mkl_interface/src, so that the QR step builds on its
+// own; keep them in sync.
+
+#include <sycl/sycl.hpp>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "telemetry.hpp"
+
+namespace example {
+
+/*
+    Replays submissions made by callable `submit_fn(q, depends)`, recorded
+    into an executable command graph of sycl_ext_oneapi_graph extension.
+
+    Submissions are recorded once, by the first call, together with `key`
+    of arguments captured by recorded tasks, e.g. their pointers. Later
+    calls with the same key replay the graph with a single submission.
+    Calls with a different key submit eagerly, so that the graph is never
+    recorded again, nor updated while executions of it are in flight.
+    Callers keep the key constant by passing arguments through storage
+    which persists across calls.
+
+    Submissions are made eagerly if the extension is not available, or if
+    recording of them is not supported, e.g. by oneMKL backend.
+
+    Calls must be serialized by the caller.
+ */
+template <typename KeyT = std::tuple<>>
+class command_graph_replay {
+public:
+    template <typename SubmitFnT>
+    sycl::event
+    submit(
+        sycl::queue &exec_q,
+        const KeyT &key,
+        SubmitFnT &&submit_fn,
+        const std::vector<sycl::event> &depends
+    )
+    {
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+        if (!unsupported_ && !exec_graph_) {
+            record(exec_q, key, submit_fn);
+        }
+
+        if (exec_graph_ && key == key_) {
+            sycl::event ev =
+                exec_q.submit([&](sycl::handler &cgh) {
+                    cgh.depends_on(depends);
+                    cgh.ext_oneapi_graph(*exec_graph_);
+                });
+            // replay of the graph counts as a single launch
+            telemetry::record_launch(exec_q, ev);
+
+            return ev;
+        }
+#endif
+        return submit_fn(exec_q, depends);
+    }
+
+    template <typename SubmitFnT>
+    sycl::event
+    submit(
+        sycl::queue &exec_q,
+        SubmitFnT &&submit_fn,
+        const std::vector<sycl::event> &depends
+    )
+    {
+        return submit(exec_q, KeyT{}, submit_fn, depends);
+    }
+
+    bool is_recorded() const {
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+        return exec_graph_.has_value();
+#else
+        return false;
+#endif
+    }
+
+private:
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+    using modifiable_graph_t =
+        sycl::ext::oneapi::experimental::command_graph<sycl::ext::oneapi::experimental::graph_state::modifiable>;
+    using executable_graph_t =
+        sycl::ext::oneapi::experimental::command_graph<sycl::ext::oneapi::experimental::graph_state::executable>;
+
+    template <typename SubmitFnT>
+    void record(sycl::queue &exec_q, const KeyT &key, SubmitFnT &submit_fn)
+    {
+        try {
+            // private out-of-order recording queue: submissions made to exec_q
+            // by other callers are not recorded, and independent submissions
+            // remain independent branches of the graph
+            sycl::queue rec_q{exec_q.get_context(), exec_q.get_device()};
+            modifiable_graph_t graph{rec_q.get_context(), rec_q.get_device()};
+
+            graph.begin_recording(rec_q);
+            try {
+                // recorded commands are not executed
+                telemetry::suspend_scope suspend{};
+                submit_fn(rec_q, std::vector<sycl::event>{});
+            } catch (...) {
+                graph.end_recording(rec_q);
+                throw;
+            }
+            graph.end_recording(rec_q);
+
+            exec_graph_.emplace(graph.finalize());
+            key_ = key;
+        } catch (const std::exception &) {
+            unsupported_ = true;
+            exec_graph_.reset();
+        }
+    }
+
+    std::optional<executable_graph_t> exec_graph_{};
+    KeyT key_{};
+    bool unsupported_ = false;
+#endif
+};
+
+} // namespace example
@@ -15,12 +15,36 @@
 #pragma once
 
 #include <sycl/sycl.hpp>
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "command_graph_replay.hpp"
+#include "telemetry.hpp"
 
 namespace example {
 
+/*
+    Anisotropic bandwidth given by factor L of bandwidth matrix H = L L^T:
+    either diagonal matrix of per-dimension smoothing parameters, content
+    of (dim, ) array, if `inverse` is nullptr, or lower-triangular Cholesky
+    factor of H, content of (dim, dim) array, with its inverse L^{-1} in
+    `inverse`. KDE with bandwidth H evaluates kernels at
+    (y - x)^T H^{-1} (y - x) = |L^{-1} (y - x)|^2, and is normalized by
+    det(L) in place of h**dim.
+ */
+template <typename T>
+struct bandwidth_factor {
+    const T* factor;
+    const T* inverse;
+};
+
 namespace detail {
 
 template <typename T>
@@ -51,54 +75,315 @@ T gaussian_density_scaling_factor(T h, std::int32_t dim)
     return gaussian_norm;
 }
 
-/*! @brief Evaluate K( dist_sq(y, x)/(h*h) )*/
+/*! @brief Evaluate squared Euclidean distance between points y and x */
 template <typename T>
-T unnormalized_gaussian_density(const T *y, const T*x, T h, std::int32_t dim) {
+T squared_distance(const T *y, const T *x, std::int32_t dim) {
     T dist_sq(0);
     for(std::int32_t k=0; k < dim; ++k) {
         T diff = y[k] - x[k];
         dist_sq += diff * diff;
     }
-    // local_sum += K( (x-x_i)/h ) / (n * h)
-    const T dist_sq_half = dist_sq / T(2);
-    const T arg = -dist_sq_half / (h*h);
-    return sycl::exp(arg);
+    return dist_sq;
 }
 
-} // namespace detail
+/*! @brief Volume of unit ball in `dim` dimensions */
+template <typename T>
+T unit_ball_volume(std::int32_t dim)
+{
+    const T two_pi = T(8) * sycl::atan(T(1));
+    // V_1 = 2, V_2 = pi, V_d = V_{d-2} * 2*pi/d
+    T vol = (dim % 2 == 1) ? T(2) : T(1);
+    for(std::int32_t k = (dim % 2 == 1) ? 3 : 2; k <= dim; k += 2) {
+        vol *= two_pi / T(k);
+    }
+    return vol;
+}
+
+/*
+    Evaluate dist_sq(y, x)/(h*h). If `bounded`, the distance is only
+    evaluated below 1, and accumulation of it over dimensions stops
+    once it reaches 1, which is returned.
+ */
+template <bool bounded = false, typename T>
+T scaled_squared_distance(const T *y, const T *x, T h, std::int32_t dim) {
+    if constexpr (bounded) {
+        const T h_sq = h * h;
+        T dist_sq(0);
+        for(std::int32_t k = 0; k < dim; ++k) {
+            T diff = y[k] - x[k];
+            dist_sq += diff * diff;
+            if (dist_sq >= h_sq) {
+                return T(1);
+            }
+        }
+        return dist_sq / h_sq;
+    } else {
+        return squared_distance(y, x, dim) / (h*h);
+    }
+}
+
+/*
+    Evaluate |L^{-1} (y - x)|^2 for bandwidth factor L, bounded as above.
+    For a Cholesky factor this costs O(dim^2) per pair of points.
+ */
+template <bool bounded = false, typename T>
+T scaled_squared_distance(const T *y, const T *x, const bandwidth_factor<T> &bw, std::int32_t dim) {
+    T dist_sq(0);
+    for(std::int32_t k = 0; k < dim; ++k) {
+        T z;
+        if (!bw.inverse) {
+            z = (y[k] - x[k]) / bw.factor[k];
+        } else {
+            z = T(0);
+            for(std::int32_t l = 0; l <= k; ++l) {
+                z += bw.inverse[k * dim + l] * (y[l] - x[l]);
+            }
+        }
+        dist_sq += z * z;
+        if constexpr (bounded) {
+            if (dist_sq >= T(1)) {
+                return T(1);
+            }
+        }
+    }
+    return dist_sq;
+}
+
+/*
+    Evaluate K( scaled_squared_distance(y, x, h) ) for kernel policy KernelT.
+    Kernels with compact support vanish at distances of 1 and beyond, so
+    their distances are bounded, skipping remaining dimensions of points
+    outside of the support.
+ */
+template <typename KernelT, typename T, typename BandwidthT>
+T unnormalized_density(const T *y, const T *x, const BandwidthT &h, std::int32_t dim) {
+    return KernelT::unnormalized(scaled_squared_distance<KernelT::compact_support>(y, x, h, dim));
+}
+
+/*! @brief Normalization factor of kernel policy KernelT with smoothing parameter h */
+template <typename KernelT, typename T>
+T kernel_normalization(T h, std::int32_t dim) {
+    return KernelT::normalization(h, dim);
+}
+
+/*! @brief Normalization factor of kernel policy KernelT with bandwidth factor L */
+template <typename KernelT, typename T>
+T kernel_normalization(const bandwidth_factor<T> &bw, std::int32_t dim) {
+    // det(L) is the product of its diagonal elements
+    T det(1);
+    for(std::int32_t k = 0; k < dim; ++k) {
+        det *= (bw.inverse) ? bw.factor[k * dim + k] : bw.factor[k];
+    }
+    return KernelT::normalization(T(1), dim) / det;
+}
 
+/*! @brief Weight of data point, unit weight unless data-set is weighted */
+template <bool weighted, typename T>
+T data_point_weight(const T *weights, size_t x_data_id) {
+    if constexpr (weighted) {
+        return weights[x_data_id];
+    } else {
+        return T(1);
+    }
+}
 
+/*
+    Divides f[t], 0 <= t < m, by sum of weights of data points, once
+    `e_f` populating f completes.
+ */
 template <typename T>
 sycl::event
-kernel_density_estimate_temps(
-    // execution queue
+divide_by_weight_sum(
     sycl::queue &exec_q,
-    // number of points to evaluate
     size_t m,
-    // dimensionality of the data
-    std::int32_t dim,
-    // points at which KDE is evaluated, content of (m, dims) array
-    const T* x_poi,
-    // where values of kde(x, h) are written to, content of (m, ) array
     T *f,
-    // Number of points in the data-set: sample from an unknown distribution
     size_t n_data,
-    // data-set, content of (n_data, dims) array
-    const T* data,
-    // smoothing parameter
-    T h,
-    // vector representing execution status of tasks that must be complete
-    // before execution of this kernel can begin
+    const T *weights,
+    const sycl::event &e_f,
     const std::vector<sycl::event> &depends
 )
 {
-    assert(dim > 0);
-    constexpr std::uint32_t n_data_per_wi = 256;
+    T *w_sum = telemetry::malloc_device<T>(1, exec_q);
+    if (!w_sum) {
+        throw std::runtime_error("Device allocation failed");
+    }
 
-    size_t n_blocks = detail::upper_quotient_of(n_data, n_data_per_wi);
+    sycl::event e_sum =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(depends);
+
+            auto w_sum_red = sycl::reduction(
+                w_sum, sycl::plus<T>(), sycl::property::reduction::initialize_to_identity{});
+            cgh.parallel_for(
+                sycl::range<1>(n_data),
+                w_sum_red,
+                [=](sycl::id<1> id, auto &sum) {
+                    sum += weights[id[0]];
+                }
+            );
+        });
+    telemetry::record_launch(exec_q, e_sum);
+
+    sycl::event e_scale =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on({e_f, e_sum});
+
+            cgh.parallel_for(
+                sycl::range<1>(m),
+                [=](sycl::item<1> it) {
+                    f[it.get_id(0)] /= *w_sum;
+                }
+            );
+        });
+    telemetry::record_launch(exec_q, e_scale);
+
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_scale);
+
+            const auto ctx = exec_q.get_context();
+            cgh.host_task([ctx, w_sum, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
+                sycl::free(w_sum, ctx);
+            });
+        });
+
+    return e_free;
+}
+
+} // namespace detail
+
+/*
+    Kernel function policies. For u = dist_squared(x, x_data)/(h*h),
+    `unnormalized(u)` evaluates profile of the radially symmetric kernel,
+    and `normalization(h, dim)` is the factor making the kernel integrate
+    to one over `dim`-dimensional space. Kernels with `compact_support`
+    vanish for u >= 1, and do not evaluate transcendental functions.
+ */
+struct gaussian_kernel {
+    static constexpr bool compact_support = false;
+
+    template <typename T>
+    static T unnormalized(T u) {
+        return sycl::exp(-u / T(2));
+    }
+
+    template <typename T>
+    static T normalization(T h, std::int32_t dim) {
+        return detail::gaussian_density_scaling_factor(h, dim);
+    }
+};
+
+/* K(u) = 1 - u, for u < 1 */
+struct epanechnikov_kernel {
+    static constexpr bool compact_support = true;
+
+    template <typename T>
+    static T unnormalized(T u) {
+        return (u < T(1)) ? T(1) - u : T(0);
+    }
+
+    template <typename T>
+    static T normalization(T h, std::int32_t dim) {
+        // integral is V_dim * 2 / (dim + 2)
+        const T integral = detail::unit_ball_volume<T>(dim) * T(2) / T(dim + 2);
+        return T(1) / (integral * sycl::pown(h, dim));
+    }
+};
+
+/* K(u) = (1 - r**3)**3, for r = sqrt(u) < 1 */
+struct tricube_kernel {
+    static constexpr bool compact_support = true;
+
+    template <typename T>
+    static T unnormalized(T u) {
+        const T one_minus_r_cubed = T(1) - u * sycl::sqrt(u);
+        return (u < T(1)) ? one_minus_r_cubed * one_minus_r_cubed * one_minus_r_cubed : T(0);
+    }
+
+    template <typename T>
+    static T normalization(T h, std::int32_t dim) {
+        // integral is V_dim * dim * (1/dim - 3/(dim+3) + 3/(dim+6) - 1/(dim+9))
+        const T d(dim);
+        const T integral =
+            detail::unit_ball_volume<T>(dim) * d * (T(1) / d - T(3) / (d + 3) + T(3) / (d + 6) - T(1) / (d + 9));
+        return T(1) / (integral * sycl::pown(h, dim));
+    }
+};
+
+/* K(u) = 1, for u < 1 */
+struct uniform_kernel {
+    static constexpr bool compact_support = true;
+
+    template <typename T>
+    static T unnormalized(T u) {
+        return (u < T(1)) ? T(1) : T(0);
+    }
+
+    template <typename T>
+    static T normalization(T h, std::int32_t dim) {
+        return T(1) / (detail::unit_ball_volume<T>(dim) * sycl::pown(h, dim));
+    }
+};
+
+
+namespace detail {
+
+// number of data points, or of partial sums, reduced by a work-item of temps implementation
+constexpr std::uint32_t temps_n_data_per_wi = 256;
+
+/* Number of elements of type T of temporaries used by temps implementation */
+inline size_t temps_temporaries_size(size_t m, size_t n_data)
+{
+    return 2 * m * upper_quotient_of(n_data, temps_n_data_per_wi);
+}
+
+/* Arguments of temps implementation which vary across calls */
+template <typename T, typename BandwidthT = T>
+struct temps_args {
+    const T* x_poi;
+    T *f;
+    const T* data;
+    const T* weights;
+    BandwidthT h;
+};
+
+// kernels of temps implementation read arguments captured by value, or,
+// when replayed from a command graph, stored in device memory
+template <typename T, typename BandwidthT>
+const temps_args<T, BandwidthT> &get_temps_args(const temps_args<T, BandwidthT> &args) { return args; }
+
+template <typename T, typename BandwidthT>
+const temps_args<T, BandwidthT> &get_temps_args(const temps_args<T, BandwidthT> *args) { return *args; }
+
+/*
+    Submits kernels of temps implementation, which use `temp` allocation of
+    `temps_temporaries_size(m, n_data)` elements for partial sums. Returns
+    event of the last kernel; `temp` may be released once it completes.
+    `args` is either temps_args, or a pointer to it in device memory,
+    which is dereferenced by kernels only, for unweighted data-sets.
+ */
+template <typename T, typename KernelT, bool weighted, typename ArgsT>
+sycl::event
+kernel_density_estimate_temps_submit(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    size_t n_data,
+    ArgsT args,
+    T *temp,
+    const std::vector<sycl::event> &depends
+)
+{
+    static_assert(!weighted || !std::is_pointer_v<ArgsT>);
+    constexpr std::uint32_t n_data_per_wi = temps_n_data_per_wi;
+
+    size_t n_blocks = upper_quotient_of(n_data, n_data_per_wi);
+
+    // weighted estimate is normalized by sum of weights at the end
+    const size_t n_norm = (weighted) ? 1 : n_data;
 
     size_t temp_size = m * n_blocks;
-    T *temp = sycl::malloc_device<T>(2 * temp_size, exec_q);
 
     T *partial_sums = temp;
     T *scratch = temp + temp_size;
@@ -114,22 +399,24 @@ kernel_density_estimate_temps(
                     size_t t = it.get_id(0);
                     size_t i_block = it.get_id(1);
 
-                    const T &gaussian_norm = detail::gaussian_density_scaling_factor(h, dim);
+                    const auto &a = get_temps_args(args);
+                    const T &kernel_norm = kernel_normalization<KernelT>(a.h, dim);
                     T local_sum(0);
 
                     for(size_t k = 0; k < n_data_per_wi; ++k) {
                         const size_t x_data_id = i_block * n_data_per_wi + k;
                         if (x_data_id < n_data) {
 
-                            const T &term = detail::unnormalized_gaussian_density(
-                                x_poi + t * dim,
-                                data + x_data_id * dim,
-                                h,
+                            const T &term = unnormalized_density<KernelT>(
+                                a.x_poi + t * dim,
+                                a.data + x_data_id * dim,
+                                a.h,
                                 dim
                             );
 
-                            // local_sum += K( (x-x_i)/h ) / (n * h)
-                            local_sum += (gaussian_norm / n_data) * term;
+                            // local_sum += w_i * K( (x-x_i)/h ) / (n * h), where
+                            // n is the sum of weights w_i if weighted, and w_i = 1 otherwise
+                            local_sum += (kernel_norm / n_norm) * data_point_weight<weighted>(a.weights, x_data_id) * term;
                         }
                     }
 
@@ -137,9 +424,10 @@ kernel_density_estimate_temps(
                 }
             );
         });
+    telemetry::record_launch(exec_q, e_partial_sums);
 
     while (n_blocks > n_data_per_wi) {
-        size_t local_n_blocks = detail::upper_quotient_of(n_blocks, n_data_per_wi);
+        size_t local_n_blocks = upper_quotient_of(n_blocks, n_data_per_wi);
 
         e_partial_sums =
             exec_q.submit([&](sycl::handler &cgh) {
@@ -165,6 +453,7 @@ kernel_density_estimate_temps(
                     }
                 );
             });
+        telemetry::record_launch(exec_q, e_partial_sums);
 
         std::swap(partial_sums, scratch);
         n_blocks = local_n_blocks;
@@ -187,22 +476,25 @@ kernel_density_estimate_temps(
                         local_sum += partial_sums[t * n_blocks + k];
                     }
 
-                    f[t] = local_sum;
+                    get_temps_args(args).f[t] = local_sum;
                 }
             );
         });
+    telemetry::record_launch(exec_q, e_partial_sums);
 
-    // wait for all kernels to finish execution and
-    // free temporary allocation
-    e_partial_sums.wait();
-    sycl::free(temp, exec_q);
+    if constexpr (weighted) {
+        e_partial_sums =
+            divide_by_weight_sum<T>(exec_q, m, args.f, n_data, args.weights, e_partial_sums, depends);
+    }
 
     return e_partial_sums;
 }
 
-template <typename T>
+} // namespace detail
+
+template <typename T, typename KernelT, bool weighted, typename BandwidthT>
 sycl::event
-kernel_density_estimate_atomic_ref(
+kernel_density_estimate_temps_impl(
     // execution queue
     sycl::queue &exec_q,
     // number of points to evaluate
@@ -217,20 +509,259 @@ kernel_density_estimate_atomic_ref(
     size_t n_data,
     // data-set, content of (n_data, dims) array
     const T* data,
-    // smoothing parameter
+    // weights of data points, content of (n_data, ) array, used if weighted
+    const T* weights,
+    // smoothing parameter, or anisotropic bandwidth_factor<T>
+    BandwidthT h,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+    telemetry::call_scope telemetry_call{"kernel_density_estimate_temps"};
+
+    T *temp = telemetry::malloc_device<T>(detail::temps_temporaries_size(m, n_data), exec_q);
+
+    sycl::event e_partial_sums =
+        detail::kernel_density_estimate_temps_submit<T, KernelT, weighted>(
+            exec_q, m, dim, n_data, detail::temps_args<T, BandwidthT>{x_poi, f, data, weights, h}, temp, depends);
+
+    // free temporary allocation once all kernels finish execution,
+    // without blocking the calling thread
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_partial_sums);
+
+            const auto ctx = exec_q.get_context();
+            cgh.host_task([ctx, temp, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
+                sycl::free(temp, ctx);
+            });
+        });
+
+    return e_free;
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_temps(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_temps_impl<T, KernelT, false>(
+        exec_q, m, dim, x_poi, f, n_data, data, nullptr, h, depends);
+}
+
+/*
+    Weighted KDE: term of data point j is scaled by weights[j], and the
+    estimate is normalized by the sum of weights instead of n_data.
+ */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_temps(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
     T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_temps_impl<T, KernelT, true>(
+        exec_q, m, dim, x_poi, f, n_data, data, weights, h, depends);
+}
+
+/* kernel_density_estimate_temps with anisotropic bandwidth, see bandwidth_factor */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_temps(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_temps_impl<T, KernelT, false>(
+        exec_q, m, dim, x_poi, f, n_data, data, nullptr, bw, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_temps(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_temps_impl<T, KernelT, true>(
+        exec_q, m, dim, x_poi, f, n_data, data, weights, bw, depends);
+}
+
+/*
+    Unweighted temps implementation for fixed number of points `m`,
+    dimensionality `dim`, and size of the data-set `n_data`.
+
+    Temporaries are allocated once. The sequence of submissions, whose
+    length depends on `n_data` through the number of reduction passes,
+    is recorded into a command graph on the first call and replayed on
+    later calls, see command_graph_replay. Recorded kernels read arrays
+    and smoothing parameter of a call from device memory, written by a
+    kernel submitted ahead of the replay, so that the graph is recorded
+    once regardless of arrays passed by calls.
+
+    Calls are executed one after another, since they share temporaries.
+    Execution queues must share context and device with `q`.
+ */
+template <typename T, typename KernelT = gaussian_kernel>
+class kernel_density_estimate_temps_graph {
+public:
+    kernel_density_estimate_temps_graph(
+        const sycl::queue &q,
+        size_t m,
+        std::int32_t dim,
+        size_t n_data
+    ) : q_(q), m_(m), dim_(dim), n_data_(n_data)
+    {
+        assert(dim > 0);
+
+        temp_ = telemetry::malloc_device<T>(detail::temps_temporaries_size(m, n_data), q_);
+        args_ = telemetry::malloc_device<detail::temps_args<T>>(1, q_);
+        if (!temp_ || !args_) {
+            sycl::free(temp_, q_);
+            sycl::free(args_, q_);
+            throw std::runtime_error("Device allocation failed");
+        }
+    }
+
+    kernel_density_estimate_temps_graph(const kernel_density_estimate_temps_graph &) = delete;
+    kernel_density_estimate_temps_graph &operator=(const kernel_density_estimate_temps_graph &) = delete;
+
+    ~kernel_density_estimate_temps_graph() {
+        // tasks using temporaries must complete before they are freed
+        last_ev_.wait();
+        sycl::free(temp_, q_);
+        sycl::free(args_, q_);
+    }
+
+    size_t get_m() const { return m_; }
+    std::int32_t get_dim() const { return dim_; }
+    size_t get_n_data() const { return n_data_; }
+    bool is_recorded() const { return replay_.is_recorded(); }
+
+    sycl::event
+    operator()(
+        sycl::queue &exec_q,
+        const T* x_poi,
+        T *f,
+        const T* data,
+        T h,
+        const std::vector<sycl::event> &depends
+    )
+    {
+        telemetry::call_scope telemetry_call{"kernel_density_estimate_temps_graph"};
+
+        std::vector<sycl::event> deps(depends);
+        deps.push_back(last_ev_);
+
+        const size_t m = m_;
+        const std::int32_t dim = dim_;
+        const size_t n_data = n_data_;
+        T *temp = temp_;
+        detail::temps_args<T> *args_ptr = args_;
+
+        const detail::temps_args<T> args{x_poi, f, data, nullptr, h};
+        sycl::event e_args =
+            exec_q.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(deps);
+                cgh.single_task([=]() { *args_ptr = args; });
+            });
+        telemetry::record_launch(exec_q, e_args);
+
+        auto submit_fn =
+            [=](sycl::queue &q, const std::vector<sycl::event> &fn_depends) {
+                return detail::kernel_density_estimate_temps_submit<T, KernelT, false>(
+                    q, m, dim, n_data, args_ptr, temp, fn_depends);
+            };
+
+        last_ev_ = replay_.submit(exec_q, submit_fn, {e_args});
+
+        return last_ev_;
+    }
+
+private:
+    sycl::queue q_;
+    size_t m_;
+    std::int32_t dim_;
+    size_t n_data_;
+    T *temp_ = nullptr;
+    detail::temps_args<T> *args_ = nullptr;
+    command_graph_replay<> replay_{};
+    sycl::event last_ev_{};
+};
+
+template <typename T, typename KernelT, bool weighted, typename BandwidthT>
+sycl::event
+kernel_density_estimate_atomic_ref_impl(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of points to evaluate
+    size_t m,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (m, dims) array
+    const T* x_poi,
+    // where values of kde(x, h) are written to, content of (m, ) array
+    T *f,
+    // Number of points in the data-set: sample from an unknown distribution
+    size_t n_data,
+    // data-set, content of (n_data, dims) array
+    const T* data,
+    // weights of data points, content of (n_data, ) array, used if weighted
+    const T* weights,
+    // smoothing parameter, or anisotropic bandwidth_factor<T>
+    BandwidthT h,
     // vector representing execution status of tasks that must be complete
     // before execution of this kernel can begin
     const std::vector<sycl::event> &depends
 )
 {
     assert(dim > 0);
+    telemetry::call_scope telemetry_call{"kernel_density_estimate_atomic_ref"};
     constexpr std::uint32_t n_data_per_wi = 256;
 
     size_t n_blocks = detail::upper_quotient_of(n_data, n_data_per_wi);
 
+    // weighted estimate is normalized by sum of weights at the end
+    const size_t n_norm = (weighted) ? 1 : n_data;
+
     sycl::event e_fill =
         exec_q.fill<T>(f, T(0), m, depends);
+    telemetry::record_launch(exec_q, e_fill);
 
     sycl::event e_kde =
         exec_q.submit([&](sycl::handler &cgh) {
@@ -243,22 +774,23 @@ kernel_density_estimate_atomic_ref(
                     size_t t = it.get_id(0);
                     size_t i_block = it.get_id(1);
 
-                    const T &gaussian_norm = detail::gaussian_density_scaling_factor(h, dim);
+                    const T &kernel_norm = detail::kernel_normalization<KernelT>(h, dim);
                     T local_sum(0);
 
                     for(size_t k = 0; k < n_data_per_wi; ++k) {
                         const size_t x_data_id = i_block * n_data_per_wi + k;
                         if (x_data_id < n_data) {
 
-                            const T &term = detail::unnormalized_gaussian_density(
+                            const T &term = detail::unnormalized_density<KernelT>(
                                 x_poi + t * dim,
                                 data + x_data_id * dim,
                                 h,
                                 dim
                             );
 
-                            // local_sum += K( (x-x_i)/h ) / (n * h)
-                            local_sum += (gaussian_norm / n_data) * term;
+                            // local_sum += w_i * K( (x-x_i)/h ) / (n * h), where
+                            // n is the sum of weights w_i if weighted, and w_i = 1 otherwise
+                            local_sum += (kernel_norm / n_norm) * detail::data_point_weight<weighted>(weights, x_data_id) * term;
                         }
                     }
 
@@ -270,29 +802,113 @@ kernel_density_estimate_atomic_ref(
                 }
             );
         });
+    telemetry::record_launch(exec_q, e_kde);
+
+    if constexpr (weighted) {
+        e_kde = detail::divide_by_weight_sum<T>(exec_q, m, f, n_data, weights, e_kde, depends);
+    }
 
     return e_kde;
 }
 
-
-/*
-    Evaluates
-
-     f(x, h) = sum(
-        1/(sqrt(2*pi)*h)**dim * exp( - dist_squared(x, x_data[j])/(2*h*h)),
-        0 <= j < n_data)
-
-    writes out f(x, h) for every x.
-
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_atomic_ref(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_atomic_ref_impl<T, KernelT, false>(
+        exec_q, m, dim, x_poi, f, n_data, data, nullptr, h, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_atomic_ref(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_atomic_ref_impl<T, KernelT, true>(
+        exec_q, m, dim, x_poi, f, n_data, data, weights, h, depends);
+}
+
+/* kernel_density_estimate_atomic_ref with anisotropic bandwidth, see bandwidth_factor */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_atomic_ref(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_atomic_ref_impl<T, KernelT, false>(
+        exec_q, m, dim, x_poi, f, n_data, data, nullptr, bw, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_atomic_ref(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_atomic_ref_impl<T, KernelT, true>(
+        exec_q, m, dim, x_poi, f, n_data, data, weights, bw, depends);
+}
+
+
+/*
+    Evaluates
+
+     f(x, h) = sum(
+        1/(sqrt(2*pi)*h)**dim * exp( - dist_squared(x, x_data[j])/(2*h*h)),
+        0 <= j < n_data) / n_data
+
+    writes out f(x, h) for every x. If `weighted`, j-th term is multiplied
+    by weights[j], and the sum is divided by sum of weights instead.
+
+    The Gaussian kernel is replaced with another kernel function by
+    policy KernelT, e.g. epanechnikov_kernel.
+
     Execution target is specified with sycl::queue argument.
 
     All pointers are expected to be USM pointers bound to the
     sycl::context used to create execution queue.
 
  */
-template <typename T>
+template <typename T, typename KernelT, bool weighted, typename BandwidthT>
 sycl::event
-kernel_density_estimate_work_group_reduce_and_atomic_ref(
+kernel_density_estimate_work_group_reduce_and_atomic_ref_impl(
     // execution queue
     sycl::queue &exec_q,
     // number of points to evaluate
@@ -307,14 +923,17 @@ kernel_density_estimate_work_group_reduce_and_atomic_ref(
     size_t n_data,
     // data-set, content of (n_data, dims) array
     const T* data,
-    // smoothing parameter
-    T h,
+    // weights of data points, content of (n_data, ) array, used if weighted
+    const T* weights,
+    // smoothing parameter, or anisotropic bandwidth_factor<T>
+    BandwidthT h,
     // vector representing execution status of tasks that must be complete
     // before execution of this kernel can begin
     const std::vector<sycl::event> &depends
 )
 {
     assert(dim > 0);
+    telemetry::call_scope telemetry_call{"kernel_density_estimate_work_group_reduce_and_atomic_ref"};
     sycl::event e, e_fill;
 
     // initialize array of function values with zeros
@@ -325,6 +944,7 @@ kernel_density_estimate_work_group_reduce_and_atomic_ref(
                 cgh.fill(f, T(0), n_evals);
             }
         );
+        telemetry::record_launch(exec_q, e_fill);
     } catch (const std::exception &e){
         std::cout << e.what() << std::endl;
         std::rethrow_exception(std::current_exception());
@@ -333,6 +953,9 @@ kernel_density_estimate_work_group_reduce_and_atomic_ref(
     const std::uint32_t wg = 512;
     constexpr std::uint32_t n_data_per_wi = 128;
 
+    // weighted estimate is normalized by sum of weights at the end
+    const size_t n_norm = (weighted) ? 1 : n_data;
+
     const size_t n_groups = detail::upper_quotient_of<size_t>(n_data, wg * n_data_per_wi);
 
     sycl::range<2> gRange(n_evals, n_groups * wg);
@@ -357,20 +980,21 @@ kernel_density_estimate_work_group_reduce_and_atomic_ref(
                         //   x_data_id = x_data_batch_id * wg * n_data_per_wi + m * wg + x_data_local_id
                         // for 0 <= m < n_wi
                         T local_sum(0);
-                        const T &gaussian_norm = detail::gaussian_density_scaling_factor(h, dim);
+                        const T &kernel_norm = detail::kernel_normalization<KernelT>(h, dim);
 
                         for(size_t m = 0; m < n_data_per_wi; ++m) {
                             size_t x_data_id = x_data_local_id + m * wg + x_data_batch_id * wg * n_data_per_wi;
                             if (x_data_id < n_data) {
-                                const T &term = detail::unnormalized_gaussian_density(
+                                const T &term = detail::unnormalized_density<KernelT>(
                                     x_poi + x_id * dim,
                                     data + x_data_id * dim,
                                     h,
                                     dim
                                 );
 
-                                // local_sum += K( (x-x_i)/h ) / (n * h)
-                                local_sum += (gaussian_norm / n_data) * term;
+                                // local_sum += w_i * K( (x-x_i)/h ) / (n * h), where
+                                // n is the sum of weights w_i if weighted, and w_i = 1 otherwise
+                                local_sum += (kernel_norm / n_norm) * detail::data_point_weight<weighted>(weights, x_data_id) * term;
                             }
                         }
 
@@ -390,15 +1014,95 @@ kernel_density_estimate_work_group_reduce_and_atomic_ref(
                     }
                 );
             });
+        telemetry::record_launch(exec_q, e);
     } catch (const std::exception &e) {
         std::cout << e.what() << std::endl;
         std::rethrow_exception(std::current_exception());
     }
 
+    if constexpr (weighted) {
+        e = detail::divide_by_weight_sum<T>(exec_q, n_evals, f, n_data, weights, e, depends);
+    }
+
     return e;
 }
 
-template <typename T>
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_work_group_reduce_and_atomic_ref(
+    sycl::queue &exec_q,
+    size_t n_evals,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref_impl<T, KernelT, false>(
+        exec_q, n_evals, dim, x_poi, f, n_data, data, nullptr, h, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_work_group_reduce_and_atomic_ref(
+    sycl::queue &exec_q,
+    size_t n_evals,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref_impl<T, KernelT, true>(
+        exec_q, n_evals, dim, x_poi, f, n_data, data, weights, h, depends);
+}
+
+/* kernel_density_estimate_work_group_reduce_and_atomic_ref with anisotropic bandwidth, see bandwidth_factor */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_work_group_reduce_and_atomic_ref(
+    sycl::queue &exec_q,
+    size_t n_evals,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref_impl<T, KernelT, false>(
+        exec_q, n_evals, dim, x_poi, f, n_data, data, nullptr, bw, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_work_group_reduce_and_atomic_ref(
+    sycl::queue &exec_q,
+    size_t n_evals,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    const bandwidth_factor<T> &bw,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref_impl<T, KernelT, true>(
+        exec_q, n_evals, dim, x_poi, f, n_data, data, weights, bw, depends);
+}
+
+template <typename T, typename KernelT = gaussian_kernel>
 sycl::event
 kernel_density_estimate(
     // execution queue
@@ -427,10 +1131,824 @@ kernel_density_estimate(
        kernel_density_estimate_atomic_ref
        kernel_density_estimate_work_group_reduce_and_atomic_ref
     */
-    return kernel_density_estimate_work_group_reduce_and_atomic_ref(
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref<T, KernelT>(
         exec_q, n, dim, x, f, n_data, data, h, depends
     );
 }
 
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate(
+    sycl::queue &exec_q,
+    size_t n,
+    std::int32_t dim,
+    const T* x,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* weights,
+    T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_work_group_reduce_and_atomic_ref<T, KernelT>(
+        exec_q, n, dim, x, f, n_data, data, weights, h, depends
+    );
+}
+
+
+/*
+    Adds `sign` times unnormalized kernel sums
+
+     sums[t] += sign * sum( K( dist_squared(x_poi[t], x_data[j])/(h*h) ), 0 <= j < n_data)
+
+    over a batch of data points, for every point of interest. Use sign = 1
+    to add a newly arrived batch, and sign = -1 to remove an expired one,
+    so that sums over a sliding window of data are maintained with work
+    proportional to the size of updates. See `kernel_density_from_sums` to
+    obtain the estimate.
+ */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_accumulate(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of points to evaluate
+    size_t n_evals,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (n_evals, dims) array
+    const T* x_poi,
+    // unnormalized sums, content of (n_evals, ) array, updated in place
+    T *sums,
+    // Number of points in the data batch
+    size_t n_data,
+    // data batch, content of (n_data, dims) array
+    const T* data,
+    // smoothing parameter
+    T h,
+    // +1 to add the batch, -1 to remove it
+    T sign,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+
+    const std::uint32_t wg = 256;
+    constexpr std::uint32_t n_data_per_wi = 64;
+
+    telemetry::call_scope telemetry_call{"kernel_density_accumulate"};
+
+    const size_t n_groups = detail::upper_quotient_of<size_t>(n_data, wg * n_data_per_wi);
+
+    sycl::event e_acc = exec_q.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(depends);
+
+        sycl::range<2> gRange(n_evals, n_groups * wg);
+        sycl::range<2> lRange(1, wg);
+
+        cgh.parallel_for(
+            sycl::nd_range<2>(gRange, lRange),
+            [=](sycl::nd_item<2> it) {
+                const size_t x_id = it.get_global_id(0);
+                const size_t x_data_batch_id = it.get_group(1);
+                const size_t x_data_local_id = it.get_local_id(1);
+
+                T local_sum(0);
+                for(size_t k = 0; k < n_data_per_wi; ++k) {
+                    size_t x_data_id = x_data_local_id + k * wg + x_data_batch_id * wg * n_data_per_wi;
+                    if (x_data_id < n_data) {
+                        local_sum += detail::unnormalized_density<KernelT>(
+                            x_poi + x_id * dim,
+                            data + x_data_id * dim,
+                            h,
+                            dim
+                        );
+                    }
+                }
+
+                auto work_group = it.get_group();
+                T sum_over_wg = sycl::reduce_over_group(work_group, local_sum, sycl::plus<T>());
+
+                if (work_group.leader()) {
+                    sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                            sycl::memory_scope::device,
+                            sycl::access::address_space::global_space> s_ref(sums[x_id]);
+                    s_ref += sign * sum_over_wg;
+                }
+            }
+        );
+    });
+    telemetry::record_launch(exec_q, e_acc);
+
+    return e_acc;
+}
+
+/*
+    Writes out KDE f[t] from unnormalized kernel sums over `n_data` data
+    points maintained by `kernel_density_accumulate`.
+ */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_from_sums(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of points to evaluate
+    size_t n_evals,
+    // dimensionality of the data
+    std::int32_t dim,
+    // unnormalized sums, content of (n_evals, ) array
+    const T *sums,
+    // where values of kde(x, h) are written to, content of (n_evals, ) array
+    T *f,
+    // Number of points in the data-set
+    size_t n_data,
+    // smoothing parameter
+    T h,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+    telemetry::call_scope telemetry_call{"kernel_density_from_sums"};
+
+    sycl::event e_kde = exec_q.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(depends);
+
+        sycl::range<1> gRange(n_evals);
+        cgh.parallel_for(
+            gRange,
+            [=](sycl::item<1> it) {
+                size_t t = it.get_id(0);
+
+                const T &kernel_norm = KernelT::normalization(h, dim);
+                f[t] = (kernel_norm / n_data) * sums[t];
+            }
+        );
+    });
+    telemetry::record_launch(exec_q, e_kde);
+
+    return e_kde;
+}
+
+
+/*
+    Computes KDE with anisotropic bandwidth: per-dimension smoothing
+    parameters (`is_diagonal` is true), or bandwidth matrix H = L L^T given
+    by its lower-triangular Cholesky factor L, content of (dim, dim) array.
+
+    Kernels apply L^{-1} to differences of points, see bandwidth_factor,
+    so neither points of interest nor the data-set are transformed. For
+    a bandwidth matrix, L^{-1} is computed into a temporary allocation of
+    dim*dim elements first. Applying it costs O(dim^2) per pair of points,
+    i.e. O(m * n_data * dim^2) in total, in place of O((m + n_data) * dim^2)
+    of whitening points once, which would need copies of both arrays. Density is estimated by `impl`, which has the
+    signature of `kernel_density_estimate` taking bandwidth_factor<T>.
+ */
+template <typename T, typename ImplT>
+sycl::event
+kernel_density_estimate_anisotropic(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of points to evaluate
+    size_t m,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (m, dims) array
+    const T* x_poi,
+    // where values of kde(x, H) are written to, content of (m, ) array
+    T *f,
+    // Number of points in the data-set: sample from an unknown distribution
+    size_t n_data,
+    // data-set, content of (n_data, dims) array
+    const T* data,
+    // bandwidth factor L
+    const T* bandwidth,
+    // whether L is diagonal
+    bool is_diagonal,
+    // implementation of KDE with bandwidth_factor<T>
+    const ImplT &impl,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+    telemetry::call_scope telemetry_call{"kernel_density_estimate_anisotropic"};
+
+    if (is_diagonal) {
+        return impl(exec_q, m, dim, x_poi, f, n_data, data, bandwidth_factor<T>{bandwidth, nullptr}, depends);
+    }
+
+    T *inverse = telemetry::malloc_device<T>(size_t(dim) * dim, exec_q);
+    if (!inverse) {
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    // inverse of lower-triangular L, column by column
+    sycl::event e_inverse =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(depends);
+
+            cgh.single_task([=]() {
+                for(std::int32_t j = 0; j < dim; ++j) {
+                    inverse[j * dim + j] = T(1) / bandwidth[j * dim + j];
+                    for(std::int32_t i = j + 1; i < dim; ++i) {
+                        T acc(0);
+                        for(std::int32_t k = j; k < i; ++k) {
+                            acc -= bandwidth[i * dim + k] * inverse[k * dim + j];
+                        }
+                        inverse[i * dim + j] = acc / bandwidth[i * dim + i];
+                    }
+                }
+            });
+        });
+    telemetry::record_launch(exec_q, e_inverse);
+
+    sycl::event e_kde =
+        impl(exec_q, m, dim, x_poi, f, n_data, data, bandwidth_factor<T>{bandwidth, inverse}, {e_inverse});
+
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_kde);
+
+            const auto ctx = exec_q.get_context();
+            cgh.host_task([ctx, inverse, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
+                sycl::free(inverse, ctx);
+            });
+        });
+
+    return e_free;
+}
+
+template <typename T>
+sycl::event
+kernel_density_estimate_anisotropic(
+    sycl::queue &exec_q,
+    size_t m,
+    std::int32_t dim,
+    const T* x_poi,
+    T *f,
+    size_t n_data,
+    const T* data,
+    const T* bandwidth,
+    bool is_diagonal,
+    const std::vector<sycl::event> &depends
+)
+{
+    return kernel_density_estimate_anisotropic<T>(
+        exec_q, m, dim, x_poi, f, n_data, data, bandwidth, is_diagonal,
+        [](sycl::queue &q, size_t m_, std::int32_t dim_, const T *x, T *f_, size_t n_, const T *data_,
+           const bandwidth_factor<T> &bw, const std::vector<sycl::event> &deps)
+        {
+            return kernel_density_estimate_work_group_reduce_and_atomic_ref<T>(q, m_, dim_, x, f_, n_, data_, bw, deps);
+        },
+        depends
+    );
+}
+
+/*
+    Evaluates leave-one-out log-likelihood of the data-set for every
+    candidate smoothing parameter h_grid[k], 0 <= k < n_h:
+
+     LL(h) = sum( log( f_i(data[i], h) ), 0 <= i < n_data)
+
+    where f_i is kernel density estimate from all data points but i-th.
+
+    Distances between pairs of data points are computed once for up to
+    `n_h_per_wi` candidate values of h, so that a grid of that size takes
+    a single pass over pairs. Bandwidth maximizing LL(h) is the
+    cross-validated choice of h.
+
+    All pointers are expected to be USM pointers bound to the
+    sycl::context used to create execution queue.
+ */
+template <typename T>
+sycl::event
+leave_one_out_log_likelihood(
+    // execution queue
+    sycl::queue &exec_q,
+    // Number of points in the data-set: sample from an unknown distribution
+    size_t n_data,
+    // dimensionality of the data
+    std::int32_t dim,
+    // data-set, content of (n_data, dims) array
+    const T* data,
+    // number of candidate smoothing parameters
+    size_t n_h,
+    // candidate smoothing parameters, content of (n_h, ) array
+    const T* h_grid,
+    // where values of LL(h) are written to, content of (n_h, ) array
+    T *log_likelihood,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+    assert(n_data > 1);
+
+    telemetry::call_scope telemetry_call{"leave_one_out_log_likelihood"};
+
+    constexpr std::uint32_t n_h_per_wi = 16;
+    const std::uint32_t wg = 256;
+    constexpr std::uint32_t n_data_per_wi = 64;
+
+    // sums of kernel values over j != i, content of (n_data, n_h) array
+    T *loo_sums = telemetry::malloc_device<T>(n_data * n_h, exec_q);
+    if (!loo_sums) {
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    sycl::event e_fill = exec_q.fill<T>(loo_sums, T(0), n_data * n_h, depends);
+    telemetry::record_launch(exec_q, e_fill);
+
+    const size_t n_groups = detail::upper_quotient_of<size_t>(n_data, wg * n_data_per_wi);
+
+    sycl::event e_sums = e_fill;
+    for(size_t h_offset = 0; h_offset < n_h; h_offset += n_h_per_wi) {
+        const std::uint32_t n_h_chunk =
+            static_cast<std::uint32_t>(std::min<size_t>(n_h_per_wi, n_h - h_offset));
+
+        e_sums =
+            exec_q.submit([&](sycl::handler &cgh) {
+                cgh.depends_on(e_sums);
+
+                sycl::range<2> gRange(n_data, n_groups * wg);
+                sycl::range<2> lRange(1, wg);
+
+                cgh.parallel_for(
+                    sycl::nd_range<2>(gRange, lRange),
+                    [=](sycl::nd_item<2> it) {
+                        const size_t i = it.get_global_id(0);
+                        const size_t x_data_batch_id = it.get_group(1);
+                        const size_t x_data_local_id = it.get_local_id(1);
+
+                        T scales[n_h_per_wi];
+                        T local_sums[n_h_per_wi];
+                        for(std::uint32_t k = 0; k < n_h_per_wi; ++k) {
+                            const T h = (k < n_h_chunk) ? h_grid[h_offset + k] : T(1);
+                            scales[k] = T(-1) / (T(2) * h * h);
+                            local_sums[k] = T(0);
+                        }
+
+                        for(size_t m = 0; m < n_data_per_wi; ++m) {
+                            size_t j = x_data_local_id + m * wg + x_data_batch_id * wg * n_data_per_wi;
+                            if (j < n_data && j != i) {
+                                const T dist_sq = detail::squared_distance(
+                                    data + i * dim, data + j * dim, dim);
+
+                                for(std::uint32_t k = 0; k < n_h_chunk; ++k) {
+                                    local_sums[k] += sycl::exp(dist_sq * scales[k]);
+                                }
+                            }
+                        }
+
+                        auto work_group = it.get_group();
+                        for(std::uint32_t k = 0; k < n_h_chunk; ++k) {
+                            T sum_over_wg = sycl::reduce_over_group(work_group, local_sums[k], sycl::plus<T>());
+
+                            if (work_group.leader()) {
+                                sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                                        sycl::memory_scope::device,
+                                        sycl::access::address_space::global_space> s_ref(loo_sums[i * n_h + h_offset + k]);
+                                s_ref += sum_over_wg;
+                            }
+                        }
+                    }
+                );
+            });
+        telemetry::record_launch(exec_q, e_sums);
+    }
+
+    sycl::event e_ll_fill =
+        exec_q.fill<T>(log_likelihood, T(0), n_h, depends);
+    telemetry::record_launch(exec_q, e_ll_fill);
+
+    // log-likelihood is a sum of logarithms of normalized sums over data points
+    const size_t n_ll_groups = detail::upper_quotient_of<size_t>(n_data, wg);
+
+    sycl::event e_ll =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on({e_sums, e_ll_fill});
+
+            sycl::range<2> gRange(n_h, n_ll_groups * wg);
+            sycl::range<2> lRange(1, wg);
+
+            cgh.parallel_for(
+                sycl::nd_range<2>(gRange, lRange),
+                [=](sycl::nd_item<2> it) {
+                    const size_t k = it.get_global_id(0);
+                    const size_t i = it.get_global_id(1);
+
+                    const T &gaussian_norm = detail::gaussian_density_scaling_factor(h_grid[k], dim);
+
+                    T term(0);
+                    if (i < n_data) {
+                        term = sycl::log((gaussian_norm / (n_data - 1)) * loo_sums[i * n_h + k]);
+                    }
+
+                    auto work_group = it.get_group();
+                    T sum_over_wg = sycl::reduce_over_group(work_group, term, sycl::plus<T>());
+
+                    if (work_group.leader()) {
+                        sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                                sycl::memory_scope::device,
+                                sycl::access::address_space::global_space> ll_ref(log_likelihood[k]);
+                        ll_ref += sum_over_wg;
+                    }
+                }
+            );
+        });
+    telemetry::record_launch(exec_q, e_ll);
+
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_ll);
+
+            const auto ctx = exec_q.get_context();
+            cgh.host_task([ctx, loo_sums, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
+                sycl::free(loo_sums, ctx);
+            });
+        });
+
+    return e_free;
+}
+
+
+/*
+    Approximate Gaussian KDE with random Fourier features. For standard
+    normal vectors omega[j] and phases offset[j] uniform in [0, 2*pi),
+    0 <= j < n_features,
+
+     exp( - dist_squared(x, y)/(2*h*h) ) ~=
+        (2/n_features) * sum( cos(omega[j].x/h + offset[j]) * cos(omega[j].y/h + offset[j]) )
+
+    so that sums of features over the data-set,
+
+     feature_sums[j] = sum( cos(omega[j].x_data[i]/h + offset[j]), 0 <= i < n_data),
+
+    computed in one pass, determine the estimate at any point in
+    O(n_features * dim) operations. Sums are accumulated into
+    `feature_sums`, so that the sketch is updated as data arrive in
+    batches; zero-initialize it before the first batch.
+
+    Work-groups load tiles of data points into local memory, which are
+    shared by work-items computing different features, as in blocked
+    matrix-matrix multiplication of data by omega^T.
+ */
+template <typename T>
+sycl::event
+random_fourier_features_update(
+    // execution queue
+    sycl::queue &exec_q,
+    // Number of points in the data batch
+    size_t n_data,
+    // dimensionality of the data
+    std::int32_t dim,
+    // data batch, content of (n_data, dims) array
+    const T* data,
+    // number of random features
+    size_t n_features,
+    // random frequencies, content of (n_features, dims) array
+    const T* omega,
+    // random phases, content of (n_features, ) array
+    const T* offset,
+    // smoothing parameter
+    T h,
+    // sums of features, content of (n_features, ) array, updated in place
+    T *feature_sums,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+
+    const std::uint32_t wg = 128;
+    // points in the tile of data held in local memory, up to 16 KB of
+    // floats for every dimensionality
+    const std::uint32_t tile_size = std::max<std::uint32_t>(1, 4096 / static_cast<std::uint32_t>(dim));
+    constexpr std::uint32_t n_tiles_per_wg = 32;
+
+    const size_t n_feature_groups = detail::upper_quotient_of<size_t>(n_features, wg);
+    const size_t n_data_groups = detail::upper_quotient_of<size_t>(n_data, tile_size * n_tiles_per_wg);
+
+    telemetry::call_scope telemetry_call{"random_fourier_features_update"};
+
+    sycl::event e_update = exec_q.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(depends);
+
+        sycl::local_accessor<T, 1> tile(sycl::range<1>(tile_size * dim), cgh);
+
+        sycl::range<2> gRange(n_data_groups, n_feature_groups * wg);
+        sycl::range<2> lRange(1, wg);
+
+        cgh.parallel_for(
+            sycl::nd_range<2>(gRange, lRange),
+            [=](sycl::nd_item<2> it) {
+                const size_t data_group_id = it.get_group(0);
+                const size_t j = it.get_global_id(1);
+                const std::uint32_t lid = it.get_local_id(1);
+
+                const T inv_h = T(1) / h;
+                const bool active = (j < n_features);
+                const T *omega_j = omega + (active ? j : 0) * dim;
+                const T offset_j = (active) ? offset[j] : T(0);
+
+                T local_sum(0);
+                for(std::uint32_t i_tile = 0; i_tile < n_tiles_per_wg; ++i_tile) {
+                    const size_t tile_begin = (data_group_id * n_tiles_per_wg + i_tile) * tile_size;
+                    if (tile_begin >= n_data) {
+                        break;
+                    }
+                    const std::uint32_t tile_len =
+                        static_cast<std::uint32_t>(std::min<size_t>(tile_size, n_data - tile_begin));
+
+                    for(std::uint32_t e = lid; e < tile_len * dim; e += wg) {
+                        tile[e] = data[tile_begin * dim + e];
+                    }
+                    sycl::group_barrier(it.get_group());
+
+                    if (active) {
+                        for(std::uint32_t p = 0; p < tile_len; ++p) {
+                            T proj(0);
+                            for(std::int32_t k = 0; k < dim; ++k) {
+                                proj += omega_j[k] * tile[p * dim + k];
+                            }
+                            local_sum += sycl::cos(proj * inv_h + offset_j);
+                        }
+                    }
+                    sycl::group_barrier(it.get_group());
+                }
+
+                if (active) {
+                    sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                            sycl::memory_scope::device,
+                            sycl::access::address_space::global_space> s_ref(feature_sums[j]);
+                    s_ref += local_sum;
+                }
+            }
+        );
+    });
+    telemetry::record_launch(exec_q, e_update);
+
+    return e_update;
+}
+
+/*
+    Evaluates approximate Gaussian KDE of the data-set of `n_data` points
+    summarized by `feature_sums`, see `random_fourier_features_update`.
+    Parameters `omega`, `offset` and `h` must be those used to compute
+    feature sums. The approximation is unbiased, and may be negative where
+    the density is small.
+ */
+template <typename T>
+sycl::event
+random_fourier_features_evaluate(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of points to evaluate
+    size_t m,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (m, dims) array
+    const T* x_poi,
+    // where values of kde(x, h) are written to, content of (m, ) array
+    T *f,
+    // number of random features
+    size_t n_features,
+    // random frequencies, content of (n_features, dims) array
+    const T* omega,
+    // random phases, content of (n_features, ) array
+    const T* offset,
+    // smoothing parameter
+    T h,
+    // sums of features, content of (n_features, ) array
+    const T *feature_sums,
+    // Number of points in the data-set summarized by feature sums
+    size_t n_data,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+
+    const std::uint32_t wg = 128;
+
+    telemetry::call_scope telemetry_call{"random_fourier_features_evaluate"};
+
+    sycl::event e_eval = exec_q.submit([&](sycl::handler &cgh) {
+        cgh.depends_on(depends);
+
+        sycl::range<2> gRange(m, wg);
+        sycl::range<2> lRange(1, wg);
+
+        cgh.parallel_for(
+            sycl::nd_range<2>(gRange, lRange),
+            [=](sycl::nd_item<2> it) {
+                const size_t t = it.get_global_id(0);
+                const std::uint32_t lid = it.get_local_id(1);
+
+                const T *y = x_poi + t * dim;
+                const T inv_h = T(1) / h;
+
+                T local_sum(0);
+                for(size_t j = lid; j < n_features; j += wg) {
+                    const T *omega_j = omega + j * dim;
+                    T proj(0);
+                    for(std::int32_t k = 0; k < dim; ++k) {
+                        proj += omega_j[k] * y[k];
+                    }
+                    local_sum += sycl::cos(proj * inv_h + offset[j]) * feature_sums[j];
+                }
+
+                auto work_group = it.get_group();
+                T sum_over_wg = sycl::reduce_over_group(work_group, local_sum, sycl::plus<T>());
+
+                if (work_group.leader()) {
+                    const T &gaussian_norm = detail::gaussian_density_scaling_factor(h, dim);
+                    f[t] = (gaussian_norm / n_data) * (T(2) / n_features) * sum_over_wg;
+                }
+            }
+        );
+    });
+    telemetry::record_launch(exec_q, e_eval);
+
+    return e_eval;
+}
+
+
+/*
+    Ragged batch of independent density estimates. Group g, 0 <= g < n_groups,
+    estimates density of data points [data_offsets[g], data_offsets[g+1]) of
+    `data`, with smoothing parameter h[g], at points of interest
+    [poi_offsets[g], poi_offsets[g+1]) of `x_poi`, writing to respective
+    elements of `f`. Groups without data points have zero density. Offsets
+    are non-decreasing, and start with zero.
+
+    Offsets and smoothing parameters are host arrays, which are copied to the
+    device along with offsets of work of groups computed on host.
+
+    Every work-item reduces a block of up to `n_data_per_wi` data points of
+    its group for one point of interest, so that the number of work-items of
+    a group is proportional to its m*n cost, and all groups are computed by
+    a single kernel launch. A work-item locates its group by binary search
+    over offsets of work.
+ */
+template <typename T, typename KernelT = gaussian_kernel>
+sycl::event
+kernel_density_estimate_ragged(
+    // execution queue
+    sycl::queue &exec_q,
+    // number of independent groups
+    size_t n_groups,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (poi_offsets[n_groups], dims) array
+    const T* x_poi,
+    // offsets of points of interest of groups, host array of (n_groups + 1, ) elements
+    const std::int64_t *poi_offsets,
+    // where values of kde(x, h) are written to, content of (poi_offsets[n_groups], ) array
+    T *f,
+    // concatenated data-sets of groups, content of (data_offsets[n_groups], dims) array
+    const T* data,
+    // offsets of data points of groups, host array of (n_groups + 1, ) elements
+    const std::int64_t *data_offsets,
+    // smoothing parameters of groups, host array of (n_groups, ) elements
+    const T *h,
+    // vector representing execution status of tasks that must be complete
+    // before execution of this kernel can begin
+    const std::vector<sycl::event> &depends
+)
+{
+    assert(dim > 0);
+    assert(poi_offsets[0] == 0 && data_offsets[0] == 0);
+    telemetry::call_scope telemetry_call{"kernel_density_estimate_ragged"};
+    constexpr std::uint32_t n_data_per_wi = 256;
+
+    const size_t total_m = poi_offsets[n_groups];
+
+    // host copies of offsets of points of interest, of data points, and of work,
+    // followed by smoothing parameters; kept alive until copied to the device
+    auto host_offsets = std::make_shared<std::vector<std::int64_t>>(3 * (n_groups + 1));
+    auto host_h = std::make_shared<std::vector<T>>(h, h + n_groups);
+
+    std::int64_t *poi_offsets_host = host_offsets->data();
+    std::int64_t *data_offsets_host = poi_offsets_host + (n_groups + 1);
+    std::int64_t *work_offsets_host = data_offsets_host + (n_groups + 1);
+
+    std::copy(poi_offsets, poi_offsets + n_groups + 1, poi_offsets_host);
+    std::copy(data_offsets, data_offsets + n_groups + 1, data_offsets_host);
+
+    work_offsets_host[0] = 0;
+    for(size_t g = 0; g < n_groups; ++g) {
+        const std::int64_t m_g = poi_offsets[g + 1] - poi_offsets[g];
+        const std::int64_t n_g = data_offsets[g + 1] - data_offsets[g];
+        const std::int64_t n_blocks = detail::upper_quotient_of(n_g, std::int64_t(n_data_per_wi));
+
+        work_offsets_host[g + 1] = work_offsets_host[g] + m_g * n_blocks;
+    }
+    const size_t total_work = work_offsets_host[n_groups];
+
+    std::int64_t *offsets_usm = telemetry::malloc_device<std::int64_t>(host_offsets->size(), exec_q);
+    T *h_usm = telemetry::malloc_device<T>(std::max<size_t>(1, n_groups), exec_q);
+    if (!offsets_usm || !h_usm) {
+        if (offsets_usm) sycl::free(offsets_usm, exec_q);
+        if (h_usm) sycl::free(h_usm, exec_q);
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    sycl::event e_copy_offsets = exec_q.copy<std::int64_t>(host_offsets->data(), offsets_usm, host_offsets->size());
+    sycl::event e_copy_h = exec_q.copy<T>(host_h->data(), h_usm, n_groups);
+    telemetry::record_transfer(exec_q, e_copy_offsets, host_offsets->size() * sizeof(std::int64_t));
+    telemetry::record_transfer(exec_q, e_copy_h, n_groups * sizeof(T));
+
+    sycl::event e_fill =
+        exec_q.fill<T>(f, T(0), total_m, depends);
+    telemetry::record_launch(exec_q, e_fill);
+
+    sycl::event e_kde =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on({e_fill, e_copy_offsets, e_copy_h});
+
+            const std::int64_t *poi_offsets_dev = offsets_usm;
+            const std::int64_t *data_offsets_dev = offsets_usm + (n_groups + 1);
+            const std::int64_t *work_offsets_dev = offsets_usm + 2 * (n_groups + 1);
+            const T *h_dev = h_usm;
+
+            sycl::range<1> gRange(total_work);
+            cgh.parallel_for(
+                gRange,
+                [=](sycl::item<1> it) {
+                    const std::int64_t w = it.get_id(0);
+
+                    // last group g with work_offsets[g] <= w, skipping groups without work
+                    size_t lo = 0;
+                    size_t hi = n_groups;
+                    while (hi - lo > 1) {
+                        const size_t mid = lo + (hi - lo) / 2;
+                        if (work_offsets_dev[mid] <= w) {
+                            lo = mid;
+                        } else {
+                            hi = mid;
+                        }
+                    }
+                    const size_t g = lo;
+
+                    const std::int64_t data_begin = data_offsets_dev[g];
+                    const std::int64_t n_g = data_offsets_dev[g + 1] - data_begin;
+                    const std::int64_t n_blocks = detail::upper_quotient_of(n_g, std::int64_t(n_data_per_wi));
+
+                    const std::int64_t local_w = w - work_offsets_dev[g];
+                    const std::int64_t t = poi_offsets_dev[g] + local_w / n_blocks;
+                    const std::int64_t i_block = local_w % n_blocks;
+
+                    const T h_g = h_dev[g];
+                    const T &kernel_norm = KernelT::normalization(h_g, dim);
+                    T local_sum(0);
+
+                    for(std::uint32_t k = 0; k < n_data_per_wi; ++k) {
+                        const std::int64_t x_data_id = i_block * n_data_per_wi + k;
+                        if (x_data_id < n_g) {
+                            local_sum += detail::unnormalized_density<KernelT>(
+                                x_poi + t * dim,
+                                data + (data_begin + x_data_id) * dim,
+                                h_g,
+                                dim
+                            );
+                        }
+                    }
+
+                    sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                            sycl::memory_scope::device,
+                            sycl::access::address_space::global_space> f_ref(f[t]);
+                    f_ref += (kernel_norm / n_g) * local_sum;
+                }
+            );
+        });
+    telemetry::record_launch(exec_q, e_kde);
+
+    // free device copies of offsets, and release host copies, once the kernel completes
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_kde);
+
+            const auto ctx = exec_q.get_context();
+            cgh.host_task([ctx, offsets_usm, h_usm, host_offsets, host_h, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
+                sycl::free(offsets_usm, ctx);
+                sycl::free(h_usm, ctx);
+            });
+        });
+
+    return e_free;
+}
 
 } // namespace example
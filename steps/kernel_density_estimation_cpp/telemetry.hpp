@@ -0,0 +1,470 @@
+// Copyright 2022-2024 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// A copy is kept in mkl_interface/src, so that the QR step builds on its
+// own; keep them in sync.
+
+// Opt-in telemetry of submissions: host time spent in phases of calls,
+// device execution time of submitted commands, bytes allocated and
+// transferred, and numbers of kernel launches, accumulated per call name.
+//
+// A call is recorded while a `call_scope` is alive on the calling thread.
+// Nested call scopes do not start new calls, so that counters of a call
+// include those of implementations it dispatches to. When telemetry is
+// disabled, recording functions only read a thread-local variable.
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace example {
+
+namespace telemetry {
+
+enum class phase : std::uint32_t {
+    // validation of arguments by the caller
+    validation = 0,
+    // device allocations of temporaries
+    allocation,
+    // remaining host time of the call, spent submitting commands
+    submission,
+    // host tasks releasing temporaries, executed asynchronously
+    cleanup,
+};
+
+constexpr std::size_t n_phases = 4;
+
+inline const char *phase_name(phase p)
+{
+    switch (p) {
+    case phase::validation:
+        return "validation";
+    case phase::allocation:
+        return "allocation";
+    case phase::submission:
+        return "submission";
+    default:
+        return "cleanup";
+    }
+}
+
+/*! @brief Counters accumulated over calls of the same name */
+struct stats {
+    std::uint64_t n_calls = 0;
+    std::uint64_t n_kernel_launches = 0;
+    std::uint64_t n_allocations = 0;
+    std::uint64_t bytes_allocated = 0;
+    std::uint64_t n_transfers = 0;
+    std::uint64_t bytes_transferred = 0;
+    // host time of phases, in nanoseconds
+    std::array<std::uint64_t, n_phases> host_ns{};
+    // commands with profiling information, i.e. submitted to queues with
+    // enable_profiling property, their total execution time, and the span
+    // of their execution, in nanoseconds of the device clock
+    std::uint64_t n_device_events = 0;
+    std::uint64_t device_ns = 0;
+    std::uint64_t device_start_ns = 0;
+    std::uint64_t device_end_ns = 0;
+};
+
+namespace detail {
+
+inline std::uint64_t now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct call_state {
+    // name of the call being recorded, nullptr if none
+    const char *name = nullptr;
+    // host time of the call attributed to phases other than submission
+    std::uint64_t attributed_ns = 0;
+    // whether recording is suspended, see suspend_scope
+    bool suspended = false;
+};
+
+inline call_state &current_call_state()
+{
+    thread_local call_state state{};
+    return state;
+}
+
+} // namespace detail
+
+/*
+    Process-wide counters. Device execution times are only available once
+    commands complete, so events of profiled commands are kept pending, and
+    are resolved when counters are read, or when too many accumulate.
+ */
+class registry {
+public:
+    static registry &instance()
+    {
+        // intentionally leaked, so that pending events are not destroyed
+        // after the SYCL runtime is torn down at exit
+        static registry *r = new registry{};
+        return *r;
+    }
+
+    bool is_enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled) noexcept { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    /*! @brief Number of resets so far, see update_if_current */
+    std::uint64_t generation() const noexcept { return generation_.load(std::memory_order_relaxed); }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stats_.clear();
+        pending_.clear();
+        generation_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename FnT>
+    void update(const char *name, FnT &&fn)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        fn(stats_[name]);
+    }
+
+    /*
+        Updates counters of `name` unless they were reset since `generation`
+        was read, e.g. by host tasks of calls submitted before the reset.
+     */
+    template <typename FnT>
+    void update_if_current(const char *name, std::uint64_t generation, FnT &&fn)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (generation == generation_.load(std::memory_order_relaxed)) {
+            fn(stats_[name]);
+        }
+    }
+
+    void add_device_event(const char *name, const sycl::event &ev)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        pending_.push_back({name, ev});
+        if (pending_.size() >= max_pending) {
+            resolve_completed();
+        }
+    }
+
+    /*! @brief Counters per call name, waiting for pending commands to complete */
+    std::map<std::string, stats> snapshot()
+    {
+        std::vector<pending_event> pending{};
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            pending.swap(pending_);
+        }
+        for(auto &p : pending) {
+            p.ev.wait();
+        }
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        for(const auto &p : pending) {
+            add_device_time(p);
+        }
+        return stats_;
+    }
+
+private:
+    // bound on events kept pending between reads of counters
+    static constexpr std::size_t max_pending = 4096;
+
+    struct pending_event {
+        const char *name;
+        sycl::event ev;
+    };
+
+    registry() = default;
+
+    void add_device_time(const pending_event &p)
+    {
+        std::uint64_t start_ns = 0;
+        std::uint64_t end_ns = 0;
+        try {
+            start_ns = p.ev.get_profiling_info<sycl::info::event_profiling::command_start>();
+            end_ns = p.ev.get_profiling_info<sycl::info::event_profiling::command_end>();
+        } catch (const sycl::exception &) {
+            // profiling information is not available for the command
+            return;
+        }
+
+        stats &s = stats_[p.name];
+        s.device_start_ns = (s.n_device_events == 0) ? start_ns : std::min(s.device_start_ns, start_ns);
+        s.device_end_ns = std::max(s.device_end_ns, end_ns);
+        s.device_ns += end_ns - start_ns;
+        s.n_device_events += 1;
+    }
+
+    // expects mutex_ to be held
+    void resolve_completed()
+    {
+        std::vector<pending_event> in_flight{};
+        for(const auto &p : pending_) {
+            const auto status = p.ev.get_info<sycl::info::event::command_execution_status>();
+            if (status == sycl::info::event_command_status::complete) {
+                add_device_time(p);
+            } else {
+                in_flight.push_back(p);
+            }
+        }
+        pending_.swap(in_flight);
+    }
+
+    std::atomic<bool> enabled_{false};
+    // incremented by reset, while mutex_ is held
+    std::atomic<std::uint64_t> generation_{0};
+    std::mutex mutex_{};
+    std::map<std::string, stats> stats_{};
+    std::vector<pending_event> pending_{};
+};
+
+inline void enable(bool enabled = true) { registry::instance().set_enabled(enabled); }
+inline bool is_enabled() { return registry::instance().is_enabled(); }
+inline void reset() { registry::instance().reset(); }
+inline std::map<std::string, stats> snapshot() { return registry::instance().snapshot(); }
+
+/*! @brief Name of the call recorded on this thread, nullptr if none */
+inline const char *current_call() { return detail::current_call_state().name; }
+
+/*! @brief Call recorded on this thread, as captured by host tasks, see cleanup_scope */
+struct cleanup_tag {
+    const char *name = nullptr;
+    std::uint64_t generation = 0;
+};
+
+inline cleanup_tag current_cleanup()
+{
+    const char *name = current_call();
+    return {name, (name) ? registry::instance().generation() : 0};
+}
+
+/*
+    Records a call named `name`, a string literal, for its lifetime, unless
+    telemetry is disabled, or a call is already recorded on this thread.
+    Host time of the call not attributed to other phases is attributed to
+    submission.
+ */
+class call_scope {
+public:
+    explicit call_scope(const char *name)
+    {
+        detail::call_state &state = detail::current_call_state();
+        if (state.name == nullptr && !state.suspended && is_enabled()) {
+            state.name = name;
+            state.attributed_ns = 0;
+            start_ns_ = detail::now_ns();
+            owner_ = true;
+        }
+    }
+
+    call_scope(const call_scope &) = delete;
+    call_scope &operator=(const call_scope &) = delete;
+
+    ~call_scope()
+    {
+        if (!owner_) {
+            return;
+        }
+
+        detail::call_state &state = detail::current_call_state();
+        const std::uint64_t total_ns = detail::now_ns() - start_ns_;
+        const std::uint64_t submission_ns =
+            (total_ns > state.attributed_ns) ? total_ns - state.attributed_ns : 0;
+
+        registry::instance().update(state.name, [&](stats &s) {
+            s.n_calls += 1;
+            s.host_ns[static_cast<std::size_t>(phase::submission)] += submission_ns;
+        });
+        state = detail::call_state{};
+    }
+
+private:
+    std::uint64_t start_ns_ = 0;
+    bool owner_ = false;
+};
+
+/*
+    Attributes host time to phase `p` of the call recorded on this thread,
+    until destroyed or stopped.
+ */
+class phase_scope {
+public:
+    explicit phase_scope(phase p) : p_(p)
+    {
+        if (current_call()) {
+            start_ns_ = detail::now_ns();
+            active_ = true;
+        }
+    }
+
+    phase_scope(const phase_scope &) = delete;
+    phase_scope &operator=(const phase_scope &) = delete;
+
+    ~phase_scope() { stop(); }
+
+    void stop()
+    {
+        if (!active_) {
+            return;
+        }
+        active_ = false;
+
+        detail::call_state &state = detail::current_call_state();
+        const std::uint64_t ns = detail::now_ns() - start_ns_;
+        state.attributed_ns += ns;
+        registry::instance().update(state.name, [&](stats &s) {
+            s.host_ns[static_cast<std::size_t>(p_)] += ns;
+        });
+    }
+
+private:
+    phase p_;
+    std::uint64_t start_ns_ = 0;
+    bool active_ = false;
+};
+
+/*
+    Attributes host time to cleanup phase of the call `tag`, obtained with
+    `current_cleanup()` at submission, in host tasks, which execute on
+    threads of the SYCL runtime. Does nothing if no call was recorded, or
+    if counters were reset since submission, so that host tasks completing
+    after a reset do not recreate counters of their call.
+ */
+class cleanup_scope {
+public:
+    explicit cleanup_scope(const cleanup_tag &tag)
+        : tag_(tag), start_ns_((tag.name) ? detail::now_ns() : 0) {}
+
+    cleanup_scope(const cleanup_scope &) = delete;
+    cleanup_scope &operator=(const cleanup_scope &) = delete;
+
+    ~cleanup_scope()
+    {
+        if (!tag_.name) {
+            return;
+        }
+
+        const std::uint64_t ns = detail::now_ns() - start_ns_;
+        registry::instance().update_if_current(tag_.name, tag_.generation, [&](stats &s) {
+            s.host_ns[static_cast<std::size_t>(phase::cleanup)] += ns;
+        });
+    }
+
+private:
+    cleanup_tag tag_;
+    std::uint64_t start_ns_;
+};
+
+/*
+    Suspends recording of the call on this thread while alive, e.g. while
+    submissions are recorded into a command graph rather than executed.
+ */
+class suspend_scope {
+public:
+    suspend_scope() : saved_(detail::current_call_state())
+    {
+        detail::call_state &state = detail::current_call_state();
+        state.name = nullptr;
+        state.suspended = true;
+    }
+
+    suspend_scope(const suspend_scope &) = delete;
+    suspend_scope &operator=(const suspend_scope &) = delete;
+
+    ~suspend_scope()
+    {
+        // host time spent while suspended is attributed to submission
+        detail::current_call_state() = saved_;
+    }
+
+private:
+    detail::call_state saved_;
+};
+
+namespace detail {
+
+inline void record_device_event(const char *name, const sycl::queue &q, const sycl::event &ev)
+{
+    if (q.has_property<sycl::property::queue::enable_profiling>()) {
+        registry::instance().add_device_event(name, ev);
+    }
+}
+
+} // namespace detail
+
+/*! @brief Records launch of a kernel, or of a library routine, with event `ev` */
+inline void record_launch(const sycl::queue &q, const sycl::event &ev)
+{
+    const char *name = current_call();
+    if (!name) {
+        return;
+    }
+
+    registry::instance().update(name, [](stats &s) { s.n_kernel_launches += 1; });
+    detail::record_device_event(name, q, ev);
+}
+
+/*! @brief Records copy of `n_bytes` between host and device with event `ev` */
+inline void record_transfer(const sycl::queue &q, const sycl::event &ev, std::size_t n_bytes)
+{
+    const char *name = current_call();
+    if (!name) {
+        return;
+    }
+
+    registry::instance().update(name, [=](stats &s) {
+        s.n_transfers += 1;
+        s.bytes_transferred += n_bytes;
+    });
+    detail::record_device_event(name, q, ev);
+}
+
+/*
+    sycl::malloc_device<T>, with time of the allocation attributed to
+    allocation phase, and its size recorded if it succeeds.
+ */
+template <typename T>
+T *malloc_device(std::size_t count, const sycl::queue &q)
+{
+    phase_scope timer{phase::allocation};
+    T *ptr = sycl::malloc_device<T>(count, q);
+
+    const char *name = current_call();
+    if (ptr && name) {
+        registry::instance().update(name, [=](stats &s) {
+            s.n_allocations += 1;
+            s.bytes_allocated += count * sizeof(T);
+        });
+    }
+
+    return ptr;
+}
+
+} // namespace telemetry
+
+} // namespace example
@@ -0,0 +1,109 @@
+// Copyright 2022-2024 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// A copy is kept in mkl_interface/src, so that the QR step builds on its
+// own; keep them in sync.
+
+// Python bindings of telemetry.hpp shared by extension modules. Every
+// module holds its own registry, so counters are recorded per module.
+
+#include <pybind11/pybind11.h>
+
+#include <map>
+#include <string>
+
+#include "telemetry.hpp"
+
+namespace example {
+
+namespace telemetry {
+
+/*
+    Returns telemetry counters of calls of this module, recorded since
+    telemetry was enabled or reset, as a dictionary keyed by call name.
+    Waits for profiled commands to complete.
+ */
+inline pybind11::dict py_stats()
+{
+    namespace py = pybind11;
+
+    std::map<std::string, stats> counters;
+    {
+        py::gil_scoped_release release;
+        counters = snapshot();
+    }
+
+    py::dict res;
+    for(const auto &[name, s] : counters) {
+        py::dict host_ns;
+        for(size_t p = 0; p < n_phases; ++p) {
+            host_ns[phase_name(static_cast<phase>(p))] = s.host_ns[p];
+        }
+
+        py::dict entry;
+        entry["n_calls"] = s.n_calls;
+        entry["n_kernel_launches"] = s.n_kernel_launches;
+        entry["n_allocations"] = s.n_allocations;
+        entry["bytes_allocated"] = s.bytes_allocated;
+        entry["n_transfers"] = s.n_transfers;
+        entry["bytes_transferred"] = s.bytes_transferred;
+        entry["host_ns"] = host_ns;
+        entry["n_device_events"] = s.n_device_events;
+        entry["device_ns"] = s.device_ns;
+        entry["device_start_ns"] = s.device_start_ns;
+        entry["device_end_ns"] = s.device_end_ns;
+
+        res[py::str(name)] = entry;
+    }
+
+    return res;
+}
+
+/*
+    Defines functions _telemetry_enable, _telemetry_is_enabled,
+    _telemetry_reset and _telemetry_stats of module `m`, used by
+    the Telemetry class of Python packages.
+ */
+inline void def_py_functions(pybind11::module_ &m)
+{
+    namespace py = pybind11;
+
+    m.def(
+        "_telemetry_enable",
+        [](bool enabled) { enable(enabled); },
+        "Enable, or disable, recording of telemetry of calls of this module",
+        py::arg("enabled")
+    );
+    m.def(
+        "_telemetry_is_enabled",
+        []() { return is_enabled(); },
+        "Whether telemetry of calls is recorded"
+    );
+    m.def(
+        "_telemetry_reset",
+        []() { reset(); },
+        "Discard recorded telemetry of calls"
+    );
+    m.def(
+        "_telemetry_stats",
+        &py_stats,
+        "Telemetry counters of calls, keyed by call name"
+    );
+}
+
+} // namespace telemetry
+
+} // namespace example
@@ -0,0 +1,44 @@
+import mkl_interface_ext as mi
+import dpctl
+import dpctl.tensor as dpt
+import numpy as np
+import timeit
+
+# Time QR decomposition of stacks of small matrices as the number of matrices
+# in the stack grows, comparing a single chain of submissions with the
+# default number of concurrent streams chosen by the extension.
+
+q = dpctl.SyclQueue()
+print(f"Using device {q.sycl_device.name}, "
+      f"max_compute_units = {q.sycl_device.max_compute_units}")
+
+dt = dpt.float32
+n = 32
+n_reps = 5
+rng = np.random.default_rng(1234)
+
+
+def time_qr(x, n_streams):
+    # warm-up, excludes JIT-compilation from timing
+    mi.qr(x, n_streams=n_streams)
+    x.sycl_queue.wait()
+
+    t0 = timeit.default_timer()
+    for _ in range(n_reps):
+        mi.qr(x, n_streams=n_streams)
+    x.sycl_queue.wait()
+    t1 = timeit.default_timer()
+
+    return (t1 - t0) / n_reps
+
+
+print(f"QR decomposition of stacks of ({n}, {n}) matrices")
+print(f"{'b':>6} {'1 stream, s':>14} {'auto, s':>14} {'speed-up':>9}")
+for b in [1, 4, 16, 64, 256, 1024]:
+    x_np = rng.standard_normal((b, n, n), dtype=dt)
+    x = dpt.asarray(x_np, sycl_queue=q)
+
+    t_single = time_qr(x, 1)
+    t_auto = time_qr(x, None)
+
+    print(f"{b:>6} {t_single:>14.6f} {t_auto:>14.6f} {t_single / t_auto:>9.2f}")
@@ -0,0 +1,203 @@
+"""
+Benchmark of QR decomposition for a sweep over matrix shapes, number of
+matrices in the stack, data types and modes of calling the extension.
+
+For every configuration the extension is warmed up (to exclude JIT-compilation
+and first-touch costs), and then timed for a number of repetitions, reporting
+medians of:
+
+  - host_s:    time for the call to return, i.e. to validate inputs and
+               submit tasks
+  - device_s:  time the device spent executing submitted tasks, from
+               profiling information of events
+  - gflops:    achieved GFLOP/s, based on device time and LAPACK flop
+               count of geqrf followed by orgqr (ungqr for complex types)
+  - numpy_s:   time taken by numpy.linalg.qr(x, mode="complete")
+  - speedup:   numpy_s / wall_s, where wall_s is the time till results
+               are available
+
+Results are written as JSON, or CSV, to be consumed by regression checks:
+
+    python benchmarks/qr_sweep.py -m 16 64 256 -b 1 64 --dtype f4 f8 \\
+        --mode qr plan --format csv --output qr_sweep.csv
+"""
+
+import argparse
+import csv
+import json
+import statistics
+import sys
+import timeit
+
+import dpctl
+import dpctl.tensor as dpt
+import numpy as np
+
+import mkl_interface_ext as mi
+
+
+def qr_flop_count(m, n, b, dtype):
+    """
+    Flop count of complete QR decomposition of `b` matrices of shape (m, n),
+    as LAPACK geqrf followed by forming (m, m) matrix Q with orgqr.
+    For square matrices each of the steps is 4/3 n**3 flops.
+    """
+    k = min(m, n)
+    geqrf = 2 * k * k * max(m, n) - 2 * k**3 / 3
+    orgqr = 4 * m * m * k - 4 * m * k * k + 4 * k**3 / 3
+    # complex multiply-add takes 4 times as many real flops
+    mult = 4 if np.issubdtype(dtype, np.complexfloating) else 1
+    return mult * b * (geqrf + orgqr)
+
+
+def random_stack(rng, b, m, n, dtype):
+    x = rng.standard_normal((b, m, n))
+    if np.issubdtype(dtype, np.complexfloating):
+        x = x + 1j * rng.standard_normal((b, m, n))
+    return x.astype(dtype)
+
+
+def time_extension(fn, x, warmup, repeat):
+    q = x.sycl_queue
+    timer = dpctl.SyclTimer(time_scale=1)
+
+    for _ in range(warmup):
+        fn(x)
+    q.wait()
+
+    host_ts, device_ts, wall_ts = [], [], []
+    for _ in range(repeat):
+        with timer(q):
+            t0 = timeit.default_timer()
+            fn(x)
+            t1 = timeit.default_timer()
+            q.wait()
+            t2 = timeit.default_timer()
+        host_ts.append(t1 - t0)
+        wall_ts.append(t2 - t0)
+        device_ts.append(timer.dt.device_dt)
+
+    return (
+        statistics.median(host_ts),
+        statistics.median(device_ts),
+        statistics.median(wall_ts),
+    )
+
+
+def time_numpy(x_np, warmup, repeat):
+    for _ in range(warmup):
+        np.linalg.qr(x_np, mode="complete")
+
+    ts = []
+    for _ in range(repeat):
+        t0 = timeit.default_timer()
+        np.linalg.qr(x_np, mode="complete")
+        ts.append(timeit.default_timer() - t0)
+
+    return statistics.median(ts)
+
+
+def run_sweep(args):
+    # profiling must be enabled for queue to report device time
+    if args.device:
+        q = dpctl.SyclQueue(args.device, property="enable_profiling")
+    else:
+        q = dpctl.SyclQueue(property="enable_profiling")
+    rng = np.random.default_rng(args.seed)
+
+    results = []
+    for dt_name in args.dtype:
+        dtype = np.dtype(dt_name)
+        try:
+            dpt.empty(tuple(), dtype=dtype, sycl_queue=q)
+        except ValueError:
+            print(f"Skipping dtype={dtype}, not supported by device", file=sys.stderr)
+            continue
+        for m in args.m:
+            for n in (args.n or [m]):
+                for b in args.b:
+                    x_np = random_stack(rng, b, m, n, dtype)
+                    x = dpt.asarray(x_np, sycl_queue=q)
+                    numpy_s = (
+                        time_numpy(x_np, args.warmup, args.repeat)
+                        if not args.no_numpy else None
+                    )
+                    for mode in args.mode:
+                        if mode == "plan":
+                            fn = mi.QRPlan(x.shape, dtype=dtype, device=q)
+                        elif mode == "plan-graph":
+                            fn = mi.QRPlan(x.shape, dtype=dtype, device=q, use_graph=True)
+                        else:
+                            fn = mi.qr
+                        host_s, device_s, wall_s = time_extension(
+                            fn, x, args.warmup, args.repeat
+                        )
+                        flops = qr_flop_count(m, n, b, dtype)
+                        results.append({
+                            "device": q.sycl_device.name,
+                            "m": m,
+                            "n": n,
+                            "b": b,
+                            "dtype": str(dtype),
+                            "mode": mode,
+                            "host_s": host_s,
+                            "device_s": device_s,
+                            "wall_s": wall_s,
+                            "gflops": flops / device_s * 1e-9 if device_s > 0 else None,
+                            "numpy_s": numpy_s,
+                            "speedup": numpy_s / wall_s if numpy_s is not None else None,
+                        })
+                        print(
+                            f"m={m} n={n} b={b} dtype={dtype} mode={mode}: "
+                            f"device {device_s:.3e} s, host {host_s:.3e} s",
+                            file=sys.stderr,
+                        )
+    return results
+
+
+def write_results(results, fmt, stream):
+    if fmt == "json":
+        json.dump(results, stream, indent=2)
+        stream.write("\n")
+    else:
+        if not results:
+            return
+        writer = csv.DictWriter(stream, fieldnames=list(results[0].keys()))
+        writer.writeheader()
+        writer.writerows(results)
+
+
+def parse_args(argv=None):
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("-m", type=int, nargs="+", default=[16, 64, 256, 1024],
+                   help="Numbers of rows of matrices")
+    p.add_argument("-n", type=int, nargs="+", default=None,
+                   help="Numbers of columns of matrices, equal to number of rows by default")
+    p.add_argument("-b", type=int, nargs="+", default=[1, 16, 256],
+                   help="Numbers of matrices in the stack")
+    p.add_argument("--dtype", nargs="+", default=["f4", "f8"],
+                   help="Data types, e.g. f4 f8 c8 c16")
+    p.add_argument("--mode", nargs="+", choices=["qr", "plan", "plan-graph"], default=["qr", "plan"],
+                   help="Call mkl_interface_ext.qr, a precomputed QRPlan, or a QRPlan replaying a command graph")
+    p.add_argument("--warmup", type=int, default=2, help="Number of warm-up calls")
+    p.add_argument("--repeat", type=int, default=10, help="Number of timed calls")
+    p.add_argument("--seed", type=int, default=1234, help="Random seed")
+    p.add_argument("--device", default="", help="SYCL filter selector string of device to use")
+    p.add_argument("--no-numpy", action="store_true", help="Skip timing numpy.linalg.qr")
+    p.add_argument("--format", choices=["json", "csv"], default="json", help="Output format")
+    p.add_argument("--output", default=None, help="Output file, standard output by default")
+    return p.parse_args(argv)
+
+
+def main(argv=None):
+    args = parse_args(argv)
+    results = run_sweep(args)
+    if args.output:
+        with open(args.output, "w", newline="") as f:
+            write_results(results, args.format, f)
+    else:
+        write_results(results, args.format, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
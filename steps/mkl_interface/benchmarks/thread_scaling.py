@@ -0,0 +1,52 @@
+import mkl_interface_ext as mi
+import dpctl
+import dpctl.tensor as dpt
+import numpy as np
+import timeit
+from concurrent.futures import ThreadPoolExecutor
+
+# Throughput of QR decomposition called concurrently from Python threads
+# sharing a queue. Calls release the GIL while submitting tasks, so that
+# host-side submission of one thread overlaps with that of other threads.
+
+q = dpctl.SyclQueue()
+print(f"Using device {q.sycl_device.name}, "
+      f"max_compute_units = {q.sycl_device.max_compute_units}")
+
+dt = dpt.float32
+b, n = 64, 32
+n_calls = 20
+rng = np.random.default_rng(1234)
+
+
+def worker(x):
+    for _ in range(n_calls):
+        mi.qr(x)
+    x.sycl_queue.wait()
+
+
+def throughput(n_threads):
+    xs = [
+        dpt.asarray(rng.standard_normal((b, n, n), dtype=dt), sycl_queue=q)
+        for _ in range(n_threads)
+    ]
+    with ThreadPoolExecutor(max_workers=n_threads) as executor:
+        # warm-up, excludes JIT-compilation and thread start-up from timing
+        list(executor.map(lambda x: mi.qr(x), xs))
+        q.wait()
+
+        t0 = timeit.default_timer()
+        list(executor.map(worker, xs))
+        t1 = timeit.default_timer()
+
+    return n_threads * n_calls / (t1 - t0)
+
+
+print(f"QR decomposition of stacks of {b} ({n}, {n}) matrices, {n_calls} calls per thread")
+print(f"{'threads':>8} {'calls/s':>12} {'scaling':>9}")
+base = None
+for n_threads in [1, 2, 4, 8]:
+    calls_per_s = throughput(n_threads)
+    if base is None:
+        base = calls_per_s
+    print(f"{n_threads:>8} {calls_per_s:>12.1f} {calls_per_s / base:>9.2f}")
@@ -1,4 +1,4 @@
-from ._qr_impl import qr
+from ._qr_impl import qr, QRPlan, telemetry, warmup
 
 __doc__ = """
 Sample Python extension built with oneAPI DPC++ and oneMKL interface library
@@ -9,4 +9,7 @@ by Nikita Grigorian and Oleksandr Pavlyk, Intel Corp.
 
 __all__ = [
     "qr",
+    "QRPlan",
+    "telemetry",
+    "warmup",
 ]
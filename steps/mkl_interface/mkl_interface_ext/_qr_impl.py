@@ -1,8 +1,11 @@
+import threading
 from typing import NamedTuple
 
 import dpctl.tensor as dpt
 import dpctl.utils as du
-from ._qr import _qr
+from . import _qr as _qr_ext
+from ._qr import _qr, _QRWorkspace, _warmup
+from ._telemetry import Telemetry
 
 
 class QRDecompositionResult(NamedTuple):
@@ -10,10 +13,18 @@ class QRDecompositionResult(NamedTuple):
     R: dpt.usm_ndarray
 
 
-def qr(x : dpt.usm_ndarray) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
+def qr(x : dpt.usm_ndarray, n_streams : int = None) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
     """
     Compute QR decomposition for a stack of matrices using 
     oneMKL interface library calls.
+
+    Real and complex floating-point data types are supported. For
+    complex inputs Q is unitary.
+
+    Matrices of the stack are factored concurrently in `n_streams`
+    independent chains of tasks. By default the number of chains is
+    chosen based on the number of compute units of the device and the
+    size of matrices.
     """
     if not isinstance(x, dpt.usm_ndarray):
         raise TypeError(
@@ -23,6 +34,12 @@ def qr(x : dpt.usm_ndarray) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
         raise ValueError(
             "Input must be a matrix, or a stack of matrices"
         )
+    if n_streams is None:
+        n_streams = 0
+    elif n_streams < 1:
+        raise ValueError(
+            f"Number of streams must be positive, got {n_streams}"
+        )
     m, n = x.shape[-2:]
     q_shape = x.shape[:-2] + (m, m,)
     r_shape = x.shape
@@ -32,6 +49,13 @@ def qr(x : dpt.usm_ndarray) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
             dpt.empty_like(x)
         )
     
+    return _qr_nonempty(x, n_streams=n_streams, workspace=None)
+
+
+def _qr_nonempty(x, n_streams=0, workspace=None):
+    m, n = x.shape[-2:]
+    q_shape = x.shape[:-2] + (m, m,)
+    r_shape = x.shape
     if x.ndim == 2:
         x = x[dpt.newaxis, ...]
     
@@ -49,20 +73,181 @@ def qr(x : dpt.usm_ndarray) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
     )
     r_f = dpt.empty_like(x_f, order="F")
 
+    _submit_qr(x.sycl_queue, x_f, q_f, r_f, n_streams, workspace)
+
+    q_f = dpt.moveaxis(q_f, -1, 0)
+    r_f = dpt.moveaxis(r_f, -1, 0)
+    q_f = dpt.reshape(q_f, q_shape)
+    r_f = dpt.reshape(r_f, r_shape)
+    return QRDecompositionResult(q_f, r_f)
+
+
+def _submit_qr(queue, a_f, q_f, r_f, n_streams, workspace):
     # either synchronize, or get dependencies and pass them 
     # to _qr via depends = list_of_events
     if hasattr(du, "SequentialOrderManager"):
-        _mgr = du.SequentialOrderManager[x.sycl_queue]
+        _mgr = du.SequentialOrderManager[queue]
         deps = _mgr.submitted_events
-        ht_ev, qr_ev = _qr(stack_of_as=x_f, stack_of_qs=q_f, stack_of_rs=r_f, depends=deps)
+        ht_ev, qr_ev = _qr(
+            stack_of_as=a_f, stack_of_qs=q_f, stack_of_rs=r_f, depends=deps, n_linear_streams=n_streams, workspace=workspace
+        )
         _mgr.add_event_pair(ht_ev, qr_ev)
     else:
-        x.sycl_queue.wait()
-        ht_ev, _ = _qr(stack_of_as=x_f, stack_of_qs=q_f, stack_of_rs=r_f)
+        queue.wait()
+        ht_ev, _ = _qr(
+            stack_of_as=a_f, stack_of_qs=q_f, stack_of_rs=r_f, n_linear_streams=n_streams, workspace=workspace
+        )
         ht_ev.wait()
 
-    q_f = dpt.moveaxis(q_f, -1, 0)
-    r_f = dpt.moveaxis(r_f, -1, 0)
-    q_f = dpt.reshape(q_f, q_shape)
-    r_f = dpt.reshape(r_f, r_shape)
-    return QRDecompositionResult(q_f, r_f)
+
+class QRPlan:
+    """
+    QR decomposition of stacks of matrices with fixed shape and data type.
+
+    Scratch-pad sizes are queried, and device memory for temporaries
+    is allocated, once when the plan is created. The plan can then be
+    called any number of times. Calls of the same plan are executed
+    one after another, since they share temporaries.
+
+    If `use_graph` is true, the plan also owns the arrays which tasks
+    read and write, so that tasks of the first call are recorded into a
+    SYCL command graph, which later calls execute with a single
+    submission. Each call copies `x` into the plan, which is needed for
+    the layout expected by oneMKL anyway, and returns copies of Q and R
+    made by the plan. Tasks are submitted eagerly if command graphs are
+    not supported by the device or by oneMKL.
+
+    Example:
+        plan = QRPlan((b, m, n), dtype="f4")
+        for x in batches:
+            q, r = plan(x)
+    """
+    def __init__(self, shape, dtype="f4", device=None, n_streams=None, use_graph=False):
+        shape = tuple(shape)
+        if len(shape) < 2:
+            raise ValueError(
+                "Shape must be that of a matrix, or of a stack of matrices"
+            )
+        if n_streams is None:
+            n_streams = 0
+        elif n_streams < 1:
+            raise ValueError(
+                f"Number of streams must be positive, got {n_streams}"
+            )
+        # allocate zero-sized array to normalize dtype and device,
+        # and to check that device supports the data type
+        proto = dpt.empty((0,), dtype=dtype, device=device)
+        m, n = shape[-2:]
+        b = 1
+        for s in shape[:-2]:
+            b *= s
+        if b * m * n == 0:
+            raise ValueError("Non-empty shape is expected")
+        self._shape = shape
+        self._dtype = proto.dtype
+        self._sycl_queue = proto.sycl_queue
+        self._workspace = _QRWorkspace(
+            sycl_queue=self._sycl_queue,
+            typenum=self._dtype.num,
+            m=m, n=n, b=b,
+            n_linear_streams=n_streams,
+            use_graph=use_graph
+        )
+        self._graph_arrays = None
+        if use_graph:
+            # arrays of the recorded graph, which persist across calls
+            a_f = dpt.empty((m, n, b), dtype=self._dtype, sycl_queue=self._sycl_queue, order="F")
+            q_f = dpt.empty((m, m, b), dtype=self._dtype, sycl_queue=self._sycl_queue, order="F")
+            r_f = dpt.empty((m, n, b), dtype=self._dtype, sycl_queue=self._sycl_queue, order="F")
+            self._graph_arrays = (a_f, q_f, r_f)
+        # calls from different threads use arrays of the plan one after
+        # another; tasks of calls from the same thread are ordered by dpctl
+        self._lock = threading.Lock()
+        self._last_thread = None
+        self._last_events = []
+
+    @property
+    def shape(self):
+        return self._shape
+
+    @property
+    def dtype(self):
+        return self._dtype
+
+    @property
+    def sycl_queue(self):
+        return self._sycl_queue
+
+    @property
+    def is_recorded(self):
+        """True if calls of the plan are executed from a command graph"""
+        return self._workspace.is_recorded
+
+    def __call__(self, x : dpt.usm_ndarray) -> tuple[dpt.usm_ndarray, dpt.usm_ndarray]:
+        """
+        Compute QR decomposition of `x`, which must have the shape
+        and data type of the plan.
+        """
+        if not isinstance(x, dpt.usm_ndarray):
+            raise TypeError(
+                f"Expected dpctl.tensor.usm_ndarray, got {type(x)}"
+            )
+        if x.shape != self._shape or x.dtype != self._dtype:
+            raise ValueError(
+                f"Plan expects array of shape {self._shape} and dtype {self._dtype}, "
+                f"got shape {x.shape} and dtype {x.dtype}"
+            )
+        if self._graph_arrays is None:
+            return _qr_nonempty(x, workspace=self._workspace)
+        if du.get_execution_queue((x.sycl_queue, self._sycl_queue)) is None:
+            raise ValueError(
+                "Array must be allocated on the device and context of the plan"
+            )
+        with self._lock:
+            return self._call_recorded(x)
+
+    def _call_recorded(self, x):
+        m, n = self._shape[-2:]
+        q_shape = self._shape[:-2] + (m, m,)
+        a_f, q_f, r_f = self._graph_arrays
+
+        if self._last_thread != threading.get_ident():
+            # tasks of the last call, made from another thread, may still
+            # use arrays of the plan
+            for ev in self._last_events:
+                ev.wait()
+
+        x = dpt.reshape(x, (-1, m, n))
+        a_f[...] = dpt.moveaxis(x, 0, -1)
+        _submit_qr(self._sycl_queue, a_f, q_f, r_f, 0, self._workspace)
+
+        q = dpt.reshape(dpt.moveaxis(q_f, -1, 0), q_shape)
+        r = dpt.reshape(dpt.moveaxis(r_f, -1, 0), self._shape)
+        res = QRDecompositionResult(
+            dpt.asarray(q, usm_type=x.usm_type, copy=True),
+            dpt.asarray(r, usm_type=x.usm_type, copy=True),
+        )
+
+        self._last_thread = threading.get_ident()
+        if hasattr(du, "SequentialOrderManager"):
+            self._last_events = du.SequentialOrderManager[self._sycl_queue].submitted_events
+        return res
+
+
+def warmup(queue=None) -> int:
+    """
+    Build device code of the extension for the device of `queue`, a
+    SyclQueue or a device specifier accepted by dpctl.tensor, ahead of
+    first use. Otherwise the first call of `qr` pays for JIT compilation
+    of kernels of the extension. Kernels of oneMKL are not affected.
+
+    Returns the number of kernels built, 0 if the device image of the
+    extension is not compatible with the device.
+    """
+    exec_q = dpt.Device.create_device(queue).sycl_queue
+    return _warmup(sycl_queue=exec_q)
+
+
+# calls are named "qr" for calls of `qr` and of `QRPlan`, and
+# "qr_workspace" for creation of plans
+telemetry = Telemetry(_qr_ext)
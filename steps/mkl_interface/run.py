@@ -1,4 +1,6 @@
 import os
+import subprocess
+import sys
 
 import mkl_interface_ext as mi
 import dpctl
@@ -12,6 +14,51 @@ print(f"Using device {dpctl.select_default_device().name}")
 # check that extension produces correct results
 pytest.main(["--no-header", os.path.abspath(os.path.dirname(__file__)) + "/tests/"])
 
+# first-call latency, measured in fresh processes where device code of the
+# extension is not built yet: the first call either pays for JIT compilation
+# of its kernels (cold), or follows warmup(), which builds them ahead of time.
+# Persistent cache of device code is disabled, so that it does not hide JIT.
+first_call_script = """
+import sys, timeit
+import mkl_interface_ext as mi
+import dpctl.tensor as dpt
+
+x_small = dpt.eye(8, dtype=dpt.float32)
+x_small.sycl_queue.wait()
+
+if sys.argv[1:] == ["warmup"]:
+    t0 = timeit.default_timer()
+    n_kernels = mi.warmup(x_small.sycl_queue)
+    print(n_kernels, timeit.default_timer() - t0)
+
+t0 = timeit.default_timer()
+mi.qr(x_small)
+x_small.sycl_queue.wait()
+print(timeit.default_timer() - t0)
+"""
+
+
+def first_call_latency(*args):
+    res = subprocess.run(
+        [sys.executable, "-c", first_call_script, *args],
+        env=dict(os.environ, SYCL_CACHE_PERSISTENT="0"),
+        cwd=os.path.dirname(os.path.abspath(__file__)),
+        capture_output=True, text=True, check=True,
+    )
+    return [float(v) for v in res.stdout.split()]
+
+
+t_cold, = first_call_latency()
+n_kernels, t_warmup, t_warm = first_call_latency("warmup")
+
+print(f"warmup built {int(n_kernels)} kernels in {t_warmup} seconds")
+print(f"first qr call latency: cold {t_cold} seconds, after warmup {t_warm} seconds")
+
+# exclude JIT compilation of kernels of the extension and of oneMKL
+# from timings below
+mi.warmup()
+mi.qr(dpt.eye(8, dtype=dpt.float32))[0].sycl_queue.wait()
+
 # now benchmark using a single large matrix
 dt = dpt.float32
 tol = 12
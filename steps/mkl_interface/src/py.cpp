@@ -1,8 +1,16 @@
 #include <sycl/sycl.hpp>
 #include "oneapi/mkl.hpp"
 
+#include <algorithm>
+#include <complex>
 #include <cstdint>
 #include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -11,10 +19,19 @@
 
 #include "dpctl4pybind11.hpp"
 #include "utils/type_dispatch.hpp"
+#include "command_graph_replay.hpp"
+#include "telemetry.hpp"
+#include "telemetry_pybind.hpp"
 
 
 namespace py = pybind11;
 namespace dpt = dpctl::tensor;
+namespace telemetry = example::telemetry;
+using example::command_graph_replay;
+
+// names of kernels identifying device images of this module, which are
+// split by optional device features used by kernels, e.g. fp64
+template <typename T> class qr_ext_warmup_krn;
 
 namespace {
 
@@ -24,6 +41,245 @@ intT round_up_mult(intT n, intT m) {
     return q * m;
 }
 
+template <typename T>
+struct is_complex : std::false_type {};
+
+template <typename T>
+struct is_complex<std::complex<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_complex_v = is_complex<T>::value;
+
+/*
+    Q is generated from elementary reflectors with orgqr for real types,
+    and with its unitary counterpart ungqr for complex types.
+ */
+template <typename T>
+std::int64_t
+q_from_reflectors_scratchpad_size(
+    sycl::queue &exec_q,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t k,
+    std::int64_t lda)
+{
+    if constexpr (is_complex_v<T>) {
+        return oneapi::mkl::lapack::ungqr_scratchpad_size<T>(exec_q, m, n, k, lda);
+    } else {
+        return oneapi::mkl::lapack::orgqr_scratchpad_size<T>(exec_q, m, n, k, lda);
+    }
+}
+
+template <typename T>
+sycl::event
+q_from_reflectors(
+    sycl::queue &exec_q,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t k,
+    T *a,
+    std::int64_t lda,
+    T *tau,
+    T *scratchpad,
+    std::int64_t scratchpad_size,
+    const std::vector<sycl::event> &depends)
+{
+    if constexpr (is_complex_v<T>) {
+        return oneapi::mkl::lapack::ungqr(
+            exec_q, m, n, k, a, lda, tau, scratchpad, scratchpad_size, depends);
+    } else {
+        return oneapi::mkl::lapack::orgqr(
+            exec_q, m, n, k, a, lda, tau, scratchpad, scratchpad_size, depends);
+    }
+}
+
+/*
+    Number of independent chains of geqrf/orgqr submissions to use for
+    a batch of `b` matrices of size (m, n).
+
+    A single factorization of a small matrix can not occupy the whole
+    device, so we estimate how many compute units one matrix keeps busy
+    from its flop count, and run as many matrices concurrently as would
+    fill the device. Every stream needs its own taus and scratch-pads,
+    hence the upper cap.
+ */
+std::int64_t
+get_number_of_linear_streams(
+    const sycl::device &d,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t b)
+{
+    constexpr std::int64_t max_linear_streams = 16;
+    // flops per compute unit below which keeping it busy is not worth it
+    constexpr std::int64_t work_per_compute_unit = std::int64_t(1) << 18;
+
+    const std::int64_t n_cu = std::max<std::int64_t>(
+        1, d.get_info<sycl::info::device::max_compute_units>());
+    const std::int64_t work_per_mat =
+        m * n * std::max(std::int64_t(1), std::min(m, n));
+    const std::int64_t cu_per_mat =
+        std::clamp<std::int64_t>(work_per_mat / work_per_compute_unit, 1, n_cu);
+
+    const std::int64_t n_streams = n_cu / cu_per_mat;
+
+    return std::clamp<std::int64_t>(n_streams, 1, std::min(b, max_linear_streams));
+}
+
+/*
+    Linear streams are independent chains of events, which are serialized
+    if submitted to an in-order queue. Returns an out-of-order queue for the
+    same context and device as `q`, reusing it across calls.
+ */
+sycl::queue
+get_out_of_order_queue(const sycl::queue &q)
+{
+    if (!q.is_in_order()) {
+        return q;
+    }
+
+    const sycl::context &ctx = q.get_context();
+    const sycl::device &dev = q.get_device();
+    const bool profiling =
+        q.has_property<sycl::property::queue::enable_profiling>();
+
+    static std::mutex cache_mutex;
+    // intentionally leaked to avoid destroying queues after SYCL runtime
+    // has been shut down at program exit
+    static auto *cache = new std::vector<sycl::queue>{};
+
+    std::lock_guard<std::mutex> lock{cache_mutex};
+    for (const auto &cached_q : *cache) {
+        if (cached_q.get_context() == ctx && cached_q.get_device() == dev &&
+            cached_q.has_property<sycl::property::queue::enable_profiling>() == profiling)
+        {
+            return cached_q;
+        }
+    }
+
+    sycl::queue ooo_q = (profiling) ?
+        sycl::queue(ctx, dev, sycl::property_list{sycl::property::queue::enable_profiling{}}) :
+        sycl::queue(ctx, dev);
+    cache->push_back(ooo_q);
+
+    return ooo_q;
+}
+
+std::int64_t
+resolve_number_of_linear_streams(
+    const sycl::device &d,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t b,
+    std::int64_t n_linear_streams)
+{
+    if (n_linear_streams <= 0) {
+        n_linear_streams = get_number_of_linear_streams(d, m, n, b);
+    }
+    return std::min(n_linear_streams, b);
+}
+
+struct qr_scratchpad_sizes {
+    std::int64_t geqrf;
+    std::int64_t orgqr;
+};
+
+struct qr_scratchpad_key {
+    sycl::device dev;
+    std::int64_t m;
+    std::int64_t n;
+
+    bool operator==(const qr_scratchpad_key &other) const {
+        return (dev == other.dev) && (m == other.m) && (n == other.n);
+    }
+};
+
+struct qr_scratchpad_key_hash {
+    std::size_t operator()(const qr_scratchpad_key &key) const {
+        std::size_t seed = std::hash<sycl::device>{}(key.dev);
+        seed ^= std::hash<std::int64_t>{}(key.m) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<std::int64_t>{}(key.n) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+/*
+    Scratch-pad sizes of geqrf and orgqr/ungqr only depend on the device,
+    the data type and the shape of matrices, so they are queried once
+    and cached. The cache is per data type, since it is a static of
+    the function template.
+ */
+template <typename T>
+qr_scratchpad_sizes
+get_qr_scratchpad_sizes(sycl::queue &exec_q, std::int64_t m, std::int64_t n)
+{
+    using cache_t = std::unordered_map<qr_scratchpad_key, qr_scratchpad_sizes, qr_scratchpad_key_hash>;
+
+    static std::mutex cache_mutex;
+    // intentionally leaked, see get_out_of_order_queue
+    static auto *cache = new cache_t{};
+
+    const qr_scratchpad_key key{exec_q.get_device(), m, n};
+    {
+        std::lock_guard<std::mutex> lock{cache_mutex};
+        auto it = cache->find(key);
+        if (it != cache->end()) {
+            return it->second;
+        }
+    }
+
+    std::int64_t lda = m;
+    std::int64_t tau_size = std::max(std::int64_t(1), std::min(m, n));
+
+    const qr_scratchpad_sizes sizes{
+        oneapi::mkl::lapack::geqrf_scratchpad_size<T>(exec_q, m, n, lda),
+        q_from_reflectors_scratchpad_size<T>(exec_q, m, m, tau_size, lda)
+    };
+
+    std::lock_guard<std::mutex> lock{cache_mutex};
+    cache->emplace(key, sizes);
+
+    return sizes;
+}
+
+/*
+    Layout of the temporary allocation used by do_qr: taus, followed by
+    geqrf scratch-pads, followed by orgqr scratch-pads, for each of
+    `n_linear_streams` streams. Sizes are in elements of type T.
+ */
+struct qr_workspace_layout {
+    std::int64_t tau_size;
+    qr_scratchpad_sizes scratch_sz;
+    size_t alloc_tau_sz;
+    size_t alloc_geqrf_scratch_sz;
+    size_t alloc_orgqr_scratch_sz;
+
+    size_t size() const {
+        return alloc_tau_sz + alloc_geqrf_scratch_sz + alloc_orgqr_scratch_sz;
+    }
+};
+
+template <typename T>
+qr_workspace_layout
+get_qr_workspace_layout(
+    sycl::queue &exec_q,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t n_linear_streams)
+{
+    qr_workspace_layout layout;
+
+    layout.tau_size = std::max(std::int64_t(1), std::min(m, n));
+    layout.scratch_sz = get_qr_scratchpad_sizes<T>(exec_q, m, n);
+
+    std::int64_t padding = 256 / sizeof(T);
+    layout.alloc_tau_sz = round_up_mult(n_linear_streams * layout.tau_size, padding);
+    layout.alloc_geqrf_scratch_sz = round_up_mult(n_linear_streams * layout.scratch_sz.geqrf, padding);
+    layout.alloc_orgqr_scratch_sz = n_linear_streams * layout.scratch_sz.orgqr;
+
+    return layout;
+}
+
 }
 
 /*
@@ -34,6 +290,19 @@ intT round_up_mult(intT n, intT m) {
 
     Number of reflectsion max(1, min(m, n)).
 
+    Supported types are real and complex floating-point types. Q is
+    orthogonal for real types, and unitary for complex types.
+
+    Matrices are distributed over `n_linear_streams` independent chains of
+    tasks submitted to an out-of-order queue sharing context and device with
+    `exec_q`. If `n_linear_streams` is not positive, it is determined from
+    the number of compute units of the device and the size of the matrices.
+
+    Temporaries are placed in `workspace`, if it is not null, which must
+    have been sized for `n_linear_streams` with get_qr_workspace_layout.
+    Otherwise they are allocated, and freed by a host task whose event
+    is returned.
+
     All input arrays have F-contig layout,
     A.strides = [1, m, m * n]
     Q.strides = [1, m, m * n]
@@ -49,40 +318,40 @@ do_qr(
     T *a,
     T *q,
     T *r,
+    std::int64_t n_linear_streams,
+    T *workspace,
     const std::vector<sycl::event> &depends)
 {
-    static_assert(std::is_floating_point_v<T>);
+    static_assert(std::is_floating_point_v<T> || is_complex_v<T>);
 
     std::int64_t lda = m;
     std::int64_t mat_size = m * n;
     std::int64_t q_size = m * m;
-    std::int64_t tau_size = std::max(std::int64_t(1), std::min(m, n));
-
-    std::int64_t n_linear_streams = (b > 16) ? 4 : ((b > 4 ? 2 : 1));
 
-    std::int64_t scratch_sz_geqrf = 
-        oneapi::mkl::lapack::geqrf_scratchpad_size<T>(exec_q, m, n, lda);
+    n_linear_streams = resolve_number_of_linear_streams(
+        exec_q.get_device(), m, n, b, n_linear_streams);
 
-    std::int64_t scratch_sz_orgqr = 
-        oneapi::mkl::lapack::orgqr_scratchpad_size<T>(exec_q, m, m, tau_size, lda);
+    // streams submitted to an in-order queue would be serialized
+    sycl::queue comp_q = (n_linear_streams > 1) ? get_out_of_order_queue(exec_q) : exec_q;
 
-    std::int64_t padding = 256 / sizeof(T);
-    size_t alloc_tau_sz = round_up_mult(n_linear_streams * tau_size, padding);
-    size_t alloc_geqrf_scratch_sz = round_up_mult(n_linear_streams * scratch_sz_geqrf, padding);
-    size_t alloc_orgqr_scratch_sz = n_linear_streams * scratch_sz_orgqr;
+    const qr_workspace_layout layout =
+        get_qr_workspace_layout<T>(exec_q, m, n, n_linear_streams);
 
-    size_t alloc_size = 
-        alloc_tau_sz + alloc_geqrf_scratch_sz + alloc_orgqr_scratch_sz;
+    std::int64_t tau_size = layout.tau_size;
+    std::int64_t scratch_sz_geqrf = layout.scratch_sz.geqrf;
+    std::int64_t scratch_sz_orgqr = layout.scratch_sz.orgqr;
 
-    // allocate memory for temporaries: taus and scratch spaces
-    T *blob = sycl::malloc_device<T>(alloc_size, exec_q);
+    // allocate memory for temporaries: taus and scratch spaces,
+    // unless a workspace was provided by the caller
+    const bool owns_blob = (workspace == nullptr);
+    T *blob = (owns_blob) ? telemetry::malloc_device<T>(layout.size(), exec_q) : workspace;
 
     if (!blob) 
         throw std::runtime_error("Device allocation failed");
 
     T *taus = blob;
-    T *scratch_geqrf = taus + alloc_tau_sz;
-    T *scratch_orgqr = scratch_geqrf + alloc_geqrf_scratch_sz;
+    T *scratch_geqrf = taus + layout.alloc_tau_sz;
+    T *scratch_orgqr = scratch_geqrf + layout.alloc_geqrf_scratch_sz;
 
     // events to manage execution graph, which is `n_linear_stream` of
     // linear graphs which tie up into memory clean-up host task
@@ -107,7 +376,8 @@ do_qr(
         sycl::event e_geqrf;
         try {
             e_geqrf = oneapi::mkl::lapack::geqrf(
-                exec_q, m, n, current_a, lda, current_tau, current_scratch_geqrf, scratch_sz_geqrf, current_dep);
+                comp_q, m, n, current_a, lda, current_tau, current_scratch_geqrf, scratch_sz_geqrf, current_dep);
+            telemetry::record_launch(comp_q, e_geqrf);
         } catch (const oneapi::mkl::lapack::exception &e) {
             std::cerr << "Exception raised by geqrf: " << e.what() << ", info = " << e.info() << std::endl;
 
@@ -115,10 +385,13 @@ do_qr(
             break;
         }
 
-        sycl::event e_copy_r = exec_q.submit([&](sycl::handler &cgh) {
+        // single pass over A populates both R and the seed of Q:
+        //   R[i, j] = (i <= j) ? A[i, j] : 0,  0 <= j < n
+        //   Q[i, j] = (j < n) ? A[i, j] : 0,   0 <= j < m
+        sycl::event e_copy_rq = comp_q.submit([&](sycl::handler &cgh) {
             cgh.depends_on(e_geqrf);
             sycl::range<2> gRange{
-                static_cast<size_t>(n),
+                static_cast<size_t>(std::max(m, n)),
                 static_cast<size_t>(m)
             };
             cgh.parallel_for(
@@ -127,49 +400,52 @@ do_qr(
                     auto i = id[1];
                     auto j = id[0];
                     auto offset = j * lda + i;
-                    current_r[offset] = (i > j) ? T(0) : current_a[offset];
-                }
-            );
-        });
-
-        sycl::event e_copy_q = exec_q.submit([&](sycl::handler &cgh) {
-            cgh.depends_on(e_geqrf);
-            sycl::range<2> gRange{
-                static_cast<size_t>(m),
-                static_cast<size_t>(m)
-            };
-            cgh.parallel_for(
-                gRange, 
-                [=](sycl::id<2> id) {
-                    auto i = id[1];
-                    auto j = id[0];
-                    auto offset = j * lda + i;
-                    current_q[offset] = (j < n) ? current_a[offset] : T(0);
+                    if (j < n) {
+                        const T a_val = current_a[offset];
+                        current_r[offset] = (i > j) ? T(0) : a_val;
+                        if (j < m) {
+                            current_q[offset] = a_val;
+                        }
+                    } else {
+                        current_q[offset] = T(0);
+                    }
                 }
             );
         });
-
+        telemetry::record_launch(comp_q, e_copy_rq);
 
         sycl::event e_orgqr; 
         try {
-            e_orgqr = oneapi::mkl::lapack::orgqr(
-                exec_q, m, m, tau_size, current_q, lda, current_tau, current_scratch_orgqr, scratch_sz_orgqr, {e_copy_q});
+            e_orgqr = q_from_reflectors<T>(
+                comp_q, m, m, tau_size, current_q, lda, current_tau, current_scratch_orgqr, scratch_sz_orgqr, {e_copy_rq});
+            telemetry::record_launch(comp_q, e_orgqr);
         } catch (const oneapi::mkl::lapack::exception &e) {
-            std::cerr << "Exception raised by orgqr: " << e.what() << ", info = " << e.info() << std::endl;
+            std::cerr << "Exception raised by " << (is_complex_v<T> ? "ungqr" : "orgqr") << ": " << e.what() << ", info = " << e.info() << std::endl;
 
             e_ptr = std::current_exception();
             break;
         }
 
 
-        comp_evs[stream_id] = {e_orgqr, e_copy_r};
+        comp_evs[stream_id] = {e_orgqr};
     }
 
     if (e_ptr) {
-        sycl::free(blob, exec_q);
+        if (owns_blob) {
+            sycl::free(blob, exec_q);
+        }
         std::rethrow_exception(e_ptr); 
     } 
 
+    if (!owns_blob) {
+        std::vector<sycl::event> all_evs;
+        for(const auto &el : comp_evs) {
+            all_evs.insert(all_evs.end(), el.begin(), el.end());
+        }
+
+        return exec_q.ext_oneapi_submit_barrier(all_evs);
+    }
+
     sycl::event ht_ev = 
         exec_q.submit([&](sycl::handler &cgh) {
             for(const auto &el : comp_evs) {
@@ -177,7 +453,8 @@ do_qr(
             }
             const auto ctx = exec_q.get_context();
 
-            cgh.host_task([ctx, blob] {
+            cgh.host_task([ctx, blob, call = telemetry::current_cleanup()] {
+                telemetry::cleanup_scope cleanup{call};
                 sycl::free(blob, ctx); 
             });
         });
@@ -185,6 +462,105 @@ do_qr(
     return ht_ev;
 }
 
+/*
+    Device allocation for temporaries of do_qr for stacks of `b` matrices
+    of shape (m, n) and given data type, which persists across calls.
+
+    Calls sharing the same workspace are serialized: each call depends
+    on the event of the previous one, recorded with `set_last_event`.
+    Callers from different threads must hold the mutex of the workspace
+    from reading the last event until recording the new one.
+
+    If `use_graph` is true, submissions of do_qr are recorded into a
+    command graph by the first call, and replayed by later calls for the
+    same arrays, which callers keep across calls. Calls for other arrays
+    are submitted eagerly.
+ */
+class QRWorkspace {
+public:
+    QRWorkspace(
+        const sycl::queue &q,
+        int typenum,
+        std::int64_t m,
+        std::int64_t n,
+        std::int64_t b,
+        std::int64_t n_linear_streams,
+        bool use_graph
+    ) : q_(q), typenum_(typenum), m_(m), n_(n), b_(b), use_graph_(use_graph)
+    {
+        telemetry::call_scope telemetry_call{"qr_workspace"};
+
+        if (m <= 0 || n <= 0 || b <= 0)
+            throw py::value_error("Matrix dimensions and number of matrices must be positive");
+
+        n_linear_streams_ = resolve_number_of_linear_streams(q_.get_device(), m, n, b, n_linear_streams);
+
+        auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+        const int type_id = array_types.typenum_to_lookup_id(typenum);
+
+        size_t alloc_nbytes = 0;
+        if (type_id == static_cast<int>(dpt::type_dispatch::typenum_t::FLOAT)) {
+            alloc_nbytes = get_qr_workspace_layout<float>(q_, m, n, n_linear_streams_).size() * sizeof(float);
+        } else if (type_id == static_cast<int>(dpt::type_dispatch::typenum_t::DOUBLE)) {
+            alloc_nbytes = get_qr_workspace_layout<double>(q_, m, n, n_linear_streams_).size() * sizeof(double);
+        } else if (type_id == static_cast<int>(dpt::type_dispatch::typenum_t::CFLOAT)) {
+            using T = std::complex<float>;
+            alloc_nbytes = get_qr_workspace_layout<T>(q_, m, n, n_linear_streams_).size() * sizeof(T);
+        } else if (type_id == static_cast<int>(dpt::type_dispatch::typenum_t::CDOUBLE)) {
+            using T = std::complex<double>;
+            alloc_nbytes = get_qr_workspace_layout<T>(q_, m, n, n_linear_streams_).size() * sizeof(T);
+        } else {
+            throw py::value_error("Unsupported data type");
+        }
+
+        blob_ = telemetry::malloc_device<char>(alloc_nbytes, q_);
+        if (!blob_)
+            throw std::runtime_error("Device allocation failed");
+    }
+
+    QRWorkspace(const QRWorkspace &) = delete;
+    QRWorkspace &operator=(const QRWorkspace &) = delete;
+
+    ~QRWorkspace() {
+        // tasks using the workspace must complete before it is freed
+        last_ev_.wait();
+        sycl::free(blob_, q_);
+    }
+
+    const sycl::queue &get_queue() const { return q_; }
+    int get_typenum() const { return typenum_; }
+    std::int64_t get_m() const { return m_; }
+    std::int64_t get_n() const { return n_; }
+    std::int64_t get_b() const { return b_; }
+    std::int64_t get_n_linear_streams() const { return n_linear_streams_; }
+    bool get_use_graph() const { return use_graph_; }
+    bool is_recorded() const { return graph_.is_recorded(); }
+
+    template <typename T>
+    T *get_data() const { return reinterpret_cast<T *>(blob_); }
+
+    std::mutex &get_mutex() { return mutex_; }
+    const sycl::event &get_last_event() const { return last_ev_; }
+    void set_last_event(const sycl::event &ev) { last_ev_ = ev; }
+
+    // key of recorded graph: pointers to stacks of A, Q and R
+    using graph_key_t = std::tuple<void *, void *, void *>;
+    command_graph_replay<graph_key_t> &get_graph_replay() { return graph_; }
+
+private:
+    sycl::queue q_;
+    int typenum_;
+    std::int64_t m_;
+    std::int64_t n_;
+    std::int64_t b_;
+    std::int64_t n_linear_streams_;
+    bool use_graph_;
+    void *blob_ = nullptr;
+    std::mutex mutex_{};
+    sycl::event last_ev_{};
+    command_graph_replay<graph_key_t> graph_{};
+};
+
 const auto &unexpected_dims0_msg = "Unexpected dimensions of input arrays. All arrays must be 3D, for stack of matrices";
 const auto &unexpected_dims1_msg = "Unexpected dimensions of input arrays. All stacks of matrices must have equal number of matrices";
 const auto &unexpected_dims2_msg = "Unexpected dimensions of input arrays. All matrices in stacks must have consistent dimensions";
@@ -192,15 +568,66 @@ const auto &unexpected_types_msg = "All arrays must have the same data type";
 const auto &unexpected_input_layout_msg = "All input arrays must be F-contiguous, indexed by (height_id, width_id, batch_id)";
 const auto &incompatible_queues_msg = "All arrays must has the same queue associated with them";
 const auto &empty_inputs_msg = "Non-empty input arrays are expected";
+const auto &incompatible_workspace_msg = "Workspace was created for a different queue, data type or shape of arrays";
+
+/*
+    Submits do_qr for stacks validated by py_qr, replaying it from the command
+    graph of the workspace if the workspace was created with `use_graph`.
+    Python objects are not accessed, so the GIL need not be held.
+ */
+template <typename T>
+sycl::event
+call_do_qr(
+    sycl::queue &exec_q,
+    std::int64_t m,
+    std::int64_t n,
+    std::int64_t b,
+    char *a_bytes,
+    char *q_bytes,
+    char *r_bytes,
+    std::int64_t n_linear_streams,
+    QRWorkspace *workspace,
+    const std::vector<sycl::event> &depends)
+{
+    T *a_data = reinterpret_cast<T *>(a_bytes);
+    T *q_data = reinterpret_cast<T *>(q_bytes);
+    T *r_data = reinterpret_cast<T *>(r_bytes);
+    T *ws_data = (workspace) ? workspace->get_data<T>() : nullptr;
+
+    if (!workspace || !workspace->get_use_graph()) {
+        return do_qr<T>(
+            exec_q,
+            m, n, b,
+            a_data, q_data, r_data,
+            n_linear_streams,
+            ws_data,
+            depends
+        );
+    }
+
+    auto submit_fn =
+        [=](sycl::queue &q, const std::vector<sycl::event> &fn_depends) {
+            return do_qr<T>(q, m, n, b, a_data, q_data, r_data, n_linear_streams, ws_data, fn_depends);
+        };
+
+    const QRWorkspace::graph_key_t key{a_data, q_data, r_data};
+
+    return workspace->get_graph_replay().submit(exec_q, key, submit_fn, depends);
+}
 
 std::pair<sycl::event, sycl::event>
 py_qr(
     dpt::usm_ndarray &stack_of_mats,
     dpt::usm_ndarray &stack_of_qs,
     dpt::usm_ndarray &stack_of_rs,
-    const std::vector<sycl::event> &depends
+    const std::vector<sycl::event> &depends,
+    py::ssize_t n_linear_streams,
+    QRWorkspace *workspace
 )
 {
+    telemetry::call_scope telemetry_call{"qr"};
+    telemetry::phase_scope validation{telemetry::phase::validation};
+
     auto mats_ndim = stack_of_mats.get_ndim();
     auto qs_ndim = stack_of_qs.get_ndim();
     auto rs_ndim = stack_of_rs.get_ndim();
@@ -255,52 +682,161 @@ py_qr(
     py::ssize_t n = s1_mats;
     py::ssize_t b = b_mats;
 
+    std::vector<sycl::event> qr_depends(depends);
+    if (workspace) {
+        bool compatible_workspace = (workspace->get_typenum() == mats_tnum);
+        compatible_workspace = compatible_workspace && (workspace->get_m() == m);
+        compatible_workspace = compatible_workspace && (workspace->get_n() == n);
+        compatible_workspace = compatible_workspace && (workspace->get_b() == b);
+        compatible_workspace = compatible_workspace &&
+            dpctl::utils::queues_are_compatible(exec_q, {workspace->get_queue()});
+
+        if (!compatible_workspace)
+            throw py::value_error(incompatible_workspace_msg);
+
+        n_linear_streams = workspace->get_n_linear_streams();
+    }
+
+    validation.stop();
+
     auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
     const int inp_typeid = array_types.typenum_to_lookup_id(mats_tnum);
-    
-    sycl::event qr_ev;
 
-    if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::FLOAT)) {
-        using T = float;
-        T *a_data = stack_of_mats.get_data<T>();
-        T *q_data = stack_of_qs.get_data<T>();
-        T *r_data = stack_of_rs.get_data<T>();
+    char *a_data = stack_of_mats.get_data();
+    char *q_data = stack_of_qs.get_data();
+    char *r_data = stack_of_rs.get_data();
 
-        qr_ev = do_qr<T>(
-            exec_q, 
-            m, n, b,
-            a_data, q_data, r_data,  
-            depends
-        );
-    } else if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::DOUBLE)) {
-        using T = double;
+    sycl::event qr_ev;
+    {
+        // submission does not access Python objects, so other Python threads
+        // may run, and submit to the same queue, meanwhile
+        py::gil_scoped_release release;
+
+        // calls sharing the workspace are serialized, see QRWorkspace
+        std::unique_lock<std::mutex> workspace_lock;
+        if (workspace) {
+            workspace_lock = std::unique_lock<std::mutex>(workspace->get_mutex());
+            qr_depends.push_back(workspace->get_last_event());
+        }
 
-        T *a_data = stack_of_mats.get_data<T>();
-        T *q_data = stack_of_qs.get_data<T>();
-        T *r_data = stack_of_rs.get_data<T>();
+        if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::FLOAT)) {
+            qr_ev = call_do_qr<float>(
+                exec_q, m, n, b, a_data, q_data, r_data, n_linear_streams, workspace, qr_depends);
+        } else if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::DOUBLE)) {
+            qr_ev = call_do_qr<double>(
+                exec_q, m, n, b, a_data, q_data, r_data, n_linear_streams, workspace, qr_depends);
+        } else if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::CFLOAT)) {
+            qr_ev = call_do_qr<std::complex<float>>(
+                exec_q, m, n, b, a_data, q_data, r_data, n_linear_streams, workspace, qr_depends);
+        } else if (inp_typeid == static_cast<int>(dpt::type_dispatch::typenum_t::CDOUBLE)) {
+            qr_ev = call_do_qr<std::complex<double>>(
+                exec_q, m, n, b, a_data, q_data, r_data, n_linear_streams, workspace, qr_depends);
+        } else {
+            throw std::runtime_error("Unsupported data type");
+        }
 
-        qr_ev = do_qr<T>(
-            exec_q, 
-            m, n, b,
-            a_data, q_data, r_data,  
-            depends
-        );
-    } else {
-        throw std::runtime_error("Unsupported data type");
+        if (workspace) {
+            workspace->set_last_event(qr_ev);
+        }
     }
 
     sycl::event ht_ev = 
-        dpctl::utils::keep_args_alive(exec_q, {stack_of_mats, stack_of_qs, stack_of_qs}, {qr_ev});
+        dpctl::utils::keep_args_alive(exec_q, {stack_of_mats, stack_of_qs, stack_of_rs}, {qr_ev});
 
     return std::make_pair(ht_ev, qr_ev);
 }
 
+template <typename T>
+void
+submit_warmup_kernel(
+    sycl::queue &exec_q,
+    const sycl::kernel_bundle<sycl::bundle_state::executable> &kb
+)
+{
+    if (!kb.has_kernel(sycl::get_kernel_id<qr_ext_warmup_krn<T>>())) {
+        return;
+    }
+
+    T *tmp = sycl::malloc_device<T>(1, exec_q);
+    if (!tmp) {
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    exec_q.submit([&](sycl::handler &cgh) {
+        cgh.use_kernel_bundle(kb);
+        cgh.single_task<qr_ext_warmup_krn<T>>([=]() { *tmp = T(1) / T(3); });
+    }).wait();
+
+    sycl::free(tmp, exec_q);
+}
+
+/*
+    Builds device code of this module for the device of `exec_q` ahead of
+    first use, so that first calls do not pay for JIT compilation of copy
+    kernels of `do_qr`. Device images of the module are split by optional
+    device features used by kernels, so every image is identified by
+    a trivial kernel defined alongside other kernels of the module, per
+    real type, which also covers respective complex type. Kernels supported
+    by the device are submitted, so that built programs are cached by the
+    runtime.
+
+    Returns the number of kernels in the built bundle.
+ */
+size_t
+py_warmup(sycl::queue &exec_q)
+{
+    py::gil_scoped_release release;
+
+    const sycl::context &ctx = exec_q.get_context();
+    const sycl::device &dev = exec_q.get_device();
+
+    std::vector<sycl::kernel_id> warmup_kids{sycl::get_kernel_id<qr_ext_warmup_krn<float>>()};
+    if (dev.has(sycl::aspect::fp64)) {
+        warmup_kids.push_back(sycl::get_kernel_id<qr_ext_warmup_krn<double>>());
+    }
+
+    if (!sycl::has_kernel_bundle<sycl::bundle_state::executable>(ctx, {dev}, warmup_kids)) {
+        return 0;
+    }
+
+    auto kb = sycl::get_kernel_bundle<sycl::bundle_state::executable>(ctx, {dev}, warmup_kids);
+
+    submit_warmup_kernel<float>(exec_q, kb);
+    submit_warmup_kernel<double>(exec_q, kb);
+
+    return kb.get_kernel_ids().size();
+}
+
 PYBIND11_MODULE(_qr, m) {
+    py::class_<QRWorkspace>(m, "_QRWorkspace")
+        .def(
+            py::init<const sycl::queue &, int, std::int64_t, std::int64_t, std::int64_t, std::int64_t, bool>(),
+            "Allocate reusable temporaries of QR decomposition for stacks of `b` matrices of shape (m, n)",
+            py::arg("sycl_queue"),
+            py::arg("typenum"),
+            py::arg("m"),
+            py::arg("n"),
+            py::arg("b"),
+            py::arg("n_linear_streams") = 0,
+            py::arg("use_graph") = false
+        )
+        .def_property_readonly("n_linear_streams", &QRWorkspace::get_n_linear_streams)
+        .def_property_readonly("is_recorded", &QRWorkspace::is_recorded);
+
     m.def("_qr", &py_qr, 
-        "Compute QR decomposition on stack of real floating-point F-contiguous arrays",
+        "Compute QR decomposition on stack of real or complex floating-point F-contiguous arrays",
         py::arg("stack_of_as"), 
         py::arg("stack_of_qs"), 
         py::arg("stack_of_rs"), 
-        py::arg("depends") = py::list()
+        py::arg("depends") = py::list(),
+        py::arg("n_linear_streams") = 0,
+        py::arg("workspace") = nullptr
+    );
+
+    telemetry::def_py_functions(m);
+
+    m.def("_warmup", &py_warmup,
+        "Build device code of the module for the device of the queue",
+        py::arg("sycl_queue")
     );
 }
\ No newline at end of file
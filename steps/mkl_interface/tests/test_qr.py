@@ -1,8 +1,10 @@
+import dpctl
 import dpctl.tensor as dpt
 import numpy as np
 import mkl_interface_ext as mi
 
 import pytest
+from concurrent.futures import ThreadPoolExecutor
 
 tol_mult = 12
 
@@ -99,3 +101,161 @@ def test_single_matrix(dt):
 
     assert res1 < tol_mult * dpt.finfo(dt).eps
     assert res2 < (tol_mult + dpt.max(dpt.abs(x))) * dpt.finfo(dt).eps
+
+
+@pytest.mark.parametrize("n_streams", [None, 1, 3, 64])
+def test_streams(dt, n_streams):
+    skip_unsupported_dt(dt)
+
+    b, n = 20, 4
+
+    x_np = np.random.randn(b, n, n).astype(dt)
+    x = dpt.asarray(x_np, dtype=dt)
+
+    q, r = mi.qr(x, n_streams=n_streams)
+
+    assert q.shape == (b, n, n,)
+    assert r.shape == x.shape
+
+    res1 = dpt.max(dpt.abs(q.mT @ q - dpt.eye(n, dtype=dt)[dpt.newaxis, ...]))
+    res2 = dpt.max(dpt.abs(q @ r - x))
+
+    assert res1 < tol_mult * dpt.finfo(dt).eps
+    assert res2 < (tol_mult + dpt.max(dpt.abs(x))) * dpt.finfo(dt).eps
+
+
+@pytest.fixture(params=[dpt.complex64, dpt.complex128])
+def complex_dt(request):
+    return request.param
+
+
+@pytest.mark.parametrize("m,n", [(4, 4), (8, 4), (3, 4)])
+def test_complex(complex_dt, m, n):
+    dt = complex_dt
+    skip_unsupported_dt(dt)
+
+    b = 10
+
+    x_np = (np.random.randn(b, m, n) + 1j * np.random.randn(b, m, n)).astype(dt)
+    x = dpt.asarray(x_np, dtype=dt)
+
+    q, r = mi.qr(x)
+
+    assert q.shape == (b, m, m,)
+    assert r.shape == x.shape
+    assert q.dtype == dt
+    assert r.dtype == dt
+
+    res1 = dpt.max(dpt.abs(dpt.conj(q.mT) @ q - dpt.eye(m, dtype=dt)[dpt.newaxis, ...]))
+    res2 = dpt.max(dpt.abs(q @ r - x))
+
+    assert res1 < tol_mult * dpt.finfo(dt).eps
+    assert res2 < (tol_mult + dpt.max(dpt.abs(x))) * dpt.finfo(dt).eps
+
+
+@pytest.mark.parametrize("use_graph", [False, True])
+def test_plan(dt, use_graph):
+    skip_unsupported_dt(dt)
+
+    b, m, n = 10, 6, 4
+
+    plan = mi.QRPlan((b, m, n), dtype=dt, use_graph=use_graph)
+
+    results = []
+    for _ in range(3):
+        x_np = np.random.randn(b, m, n).astype(dt)
+        x = dpt.asarray(x_np, dtype=dt)
+
+        q, r = plan(x)
+
+        assert q.shape == (b, m, m,)
+        assert r.shape == x.shape
+        results.append((x, q, r))
+
+    # results of earlier calls are not overwritten by later ones
+    for x, q, r in results:
+        res1 = dpt.max(dpt.abs(q.mT @ q - dpt.eye(m, dtype=dt)[dpt.newaxis, ...]))
+        res2 = dpt.max(dpt.abs(q @ r - x))
+
+        assert res1 < tol_mult * dpt.finfo(dt).eps
+        assert res2 < (tol_mult + dpt.max(dpt.abs(x))) * dpt.finfo(dt).eps
+
+
+@pytest.mark.parametrize("n_threads", [2, 8])
+def test_concurrent_threads(dt, n_threads):
+    skip_unsupported_dt(dt)
+
+    b, m, n = 6, 8, 5
+    n_calls = 4
+
+    # all arrays, and the plan, share the queue of the default device
+    xs = [
+        dpt.asarray(np.random.randn(b, m, n).astype(dt), dtype=dt)
+        for _ in range(n_threads)
+    ]
+    plan = mi.QRPlan((b, m, n), dtype=dt)
+    eye = dpt.eye(m, dtype=dt)[dpt.newaxis, ...]
+
+    def worker(x):
+        res = []
+        for i in range(n_calls):
+            q, r = plan(x) if i % 2 else mi.qr(x)
+            res1 = dpt.max(dpt.abs(q.mT @ q - eye))
+            res2 = dpt.max(dpt.abs(q @ r - x))
+            res.append((float(res1), float(res2)))
+        return res
+
+    with ThreadPoolExecutor(max_workers=n_threads) as executor:
+        all_res = list(executor.map(worker, xs))
+
+    for x, res in zip(xs, all_res):
+        x_max = float(dpt.max(dpt.abs(x)))
+        for res1, res2 in res:
+            assert res1 < tol_mult * dpt.finfo(dt).eps
+            assert res2 < (tol_mult + x_max) * dpt.finfo(dt).eps
+
+
+def test_telemetry(dt):
+    skip_unsupported_dt(dt)
+
+    b, m, n = 6, 8, 5
+
+    q = dpctl.SyclQueue(property="enable_profiling")
+    x = dpt.asarray(np.random.randn(b, m, n).astype(dt), dtype=dt, sycl_queue=q)
+
+    mi.telemetry.reset()
+    with mi.telemetry:
+        assert mi.telemetry.enabled
+        mi.qr(x)
+    assert not mi.telemetry.enabled
+    # calls made while telemetry is disabled are not recorded
+    mi.qr(x)
+
+    stats = mi.telemetry.stats()["qr"]
+    assert stats.n_calls == 1
+    # geqrf, copy of R and of the seed of Q, and orgqr, per matrix
+    assert stats.n_kernel_launches == 3 * b
+    assert stats.n_allocations == 1
+    assert stats.bytes_allocated > 0
+    assert stats.n_transfers == 0
+    assert set(stats.host_ns) == {"validation", "allocation", "submission", "cleanup"}
+    assert 0 < stats.n_device_events <= stats.n_kernel_launches
+    assert stats.device_start_ns <= stats.device_end_ns
+
+    mi.telemetry.reset()
+    assert "qr" not in mi.telemetry.stats()
+
+
+def test_plan_validation(dt):
+    skip_unsupported_dt(dt)
+
+    plan = mi.QRPlan((10, 4, 4), dtype=dt)
+
+    with pytest.raises(ValueError):
+        plan(dpt.zeros((10, 4, 3), dtype=dt))
+
+    with pytest.raises(ValueError):
+        plan(dpt.zeros((10, 4, 4), dtype=dpt.int32))
+
+    with pytest.raises(ValueError):
+        mi.QRPlan((0, 4, 4), dtype=dt)
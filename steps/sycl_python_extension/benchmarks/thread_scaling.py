@@ -0,0 +1,67 @@
+import kde_sycl_ext as kse
+import dpctl
+import dpctl.tensor as dpt
+import numpy as np
+import timeit
+from concurrent.futures import ThreadPoolExecutor
+
+# Throughput of kde_ext called concurrently from Python threads sharing a
+# queue. Calls release the GIL while submitting tasks, so that host-side
+# submission of one thread overlaps with that of other threads. Calls of
+# mode 3 of the same shapes replay one command graph, and are serialized.
+
+q = dpctl.SyclQueue()
+print(f"Using device {q.sycl_device.name}, "
+      f"max_compute_units = {q.sycl_device.max_compute_units}")
+
+dt = dpt.float32
+n_sample, n_dim, n_est = 100_000, 3, 64
+h = 0.05
+n_calls = 20
+rng = np.random.default_rng(1234)
+
+sample = dpt.asarray(rng.uniform(0, 1, size=(n_sample, n_dim)).astype(dt), sycl_queue=q)
+
+
+def worker(poi, mode):
+    for _ in range(n_calls):
+        pdf = kse.kde_ext(poi, sample, h, mode=mode)
+    pdf.sycl_queue.wait()
+    return pdf
+
+
+def throughput(n_threads, mode):
+    pois = [
+        dpt.asarray(rng.uniform(0.1, 0.9, size=(n_est, n_dim)).astype(dt), sycl_queue=q)
+        for _ in range(n_threads)
+    ]
+    # results of calls made by a single thread, also excludes JIT-compilation
+    # and recording of command graphs from timing
+    expected = [kse.kde_ext(poi, sample, h, mode=mode) for poi in pois]
+    q.wait()
+
+    with ThreadPoolExecutor(max_workers=n_threads) as executor:
+        # warm-up, excludes thread start-up from timing
+        list(executor.map(lambda poi: kse.kde_ext(poi, sample, h, mode=mode), pois))
+        q.wait()
+
+        t0 = timeit.default_timer()
+        results = list(executor.map(lambda poi: worker(poi, mode), pois))
+        t1 = timeit.default_timer()
+
+    # calls of other threads do not interfere with results
+    for res, ref in zip(results, expected):
+        assert dpt.allclose(res, ref)
+
+    return n_threads * n_calls / (t1 - t0)
+
+
+print(f"KDE for n_sample = {n_sample}, n_est = {n_est}, n_dim = {n_dim}, {n_calls} calls per thread")
+print(f"{'mode':>5} {'threads':>8} {'calls/s':>12} {'scaling':>9}")
+for mode in [0, 1, 2, 3]:
+    base = None
+    for n_threads in [1, 2, 4, 8]:
+        calls_per_s = throughput(n_threads, mode)
+        if base is None:
+            base = calls_per_s
+        print(f"{mode:>5} {n_threads:>8} {calls_per_s:>12.1f} {calls_per_s / base:>9.2f}")
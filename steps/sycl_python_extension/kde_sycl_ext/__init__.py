@@ -1,3 +1,12 @@
-from ._kde_impls import kde_dpctl, kde_ext, kde_numpy
+from ._kde_host_impls import kde_host, kde_numpy
 
-__all__ = ["kde_dpctl", "kde_ext", "kde_numpy"]
+__all__ = ["kde_host", "kde_numpy"]
+
+try:
+    from ._kde_impls import kde_dpctl, kde_ext, select_bandwidth, kde_ragged, RandomFourierKDE, StreamingKDE, telemetry, warmup
+except ImportError:
+    # SYCL runtime or dpctl are not available, only
+    # host implementations can be used
+    pass
+else:
+    __all__ += ["kde_dpctl", "kde_ext", "select_bandwidth", "kde_ragged", "RandomFourierKDE", "StreamingKDE", "telemetry", "warmup"]
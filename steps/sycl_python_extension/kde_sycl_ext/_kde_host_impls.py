@@ -0,0 +1,52 @@
+import numpy as np
+from ._kde_host_ext import _kde_host
+from ._validation import _validate_inputs
+
+
+def kde_host(poi: np.ndarray, sample: np.ndarray, h: float, n_threads=None, out=None) -> np.ndarray:
+    """Given a sample from underlying continuous distribution and
+    a smoothing parameter `h`, evaluate density estimate at each point of
+    interest `poi` on the host, using `n_threads` threads (all available
+    hardware threads by default).
+
+    Only the Gaussian kernel is supported; kernel functions with compact
+    support are evaluated by `kde_ext` with `kernel` argument.
+
+    Does not require SYCL runtime. C-contiguous inputs are used without
+    copying. If `out` is provided, estimates are written into it, and it
+    is returned.
+    """
+    m, _, _, h = _validate_inputs(poi, sample, h, np.ndarray)
+    if n_threads is None:
+        n_threads = 0
+    elif n_threads < 1:
+        raise ValueError(f"Number of threads must be positive, got {n_threads}")
+    # no-op for C-contiguous arrays of matching type
+    dt = np.result_type(poi.dtype, sample.dtype, np.float32)
+    poi = np.ascontiguousarray(poi, dtype=dt)
+    sample = np.ascontiguousarray(sample, dtype=dt)
+    if out is None:
+        pdf = np.empty((m,), dtype=dt)
+    else:
+        if not isinstance(out, np.ndarray):
+            raise TypeError(
+                f"Expected output array of type {np.ndarray}, got {type(out)}"
+            )
+        if out.shape != (m,) or out.dtype != dt:
+            raise ValueError(
+                f"Output array must have shape {(m,)} and dtype {dt}, "
+                f"got shape {out.shape} and dtype {out.dtype}"
+            )
+        pdf = out
+    _kde_host(poi=poi, sample=sample, h=h, pdf=pdf, n_threads=n_threads)
+    return pdf
+
+
+def kde_numpy(poi: np.ndarray, sample: np.ndarray, h: float) -> np.ndarray:
+    """Given a sample from underlying continuous distribution and
+    a smoothing parameter `h`, evaluate density estimate at each point of
+    interest `poi` with the Gaussian kernel.
+    """
+    _, _, d, h = _validate_inputs(poi, sample, h, np.ndarray)
+    dm = np.sum(np.square(poi[:, np.newaxis, ...] - sample[np.newaxis, ...]), axis=-1)
+    return np.mean(np.exp(dm/(-2*h*h)), axis=-1)/np.power(np.sqrt(2*np.pi) * h, d)
@@ -1,69 +1,622 @@
+from collections import deque
+from typing import NamedTuple
+
 import numpy as np
 import dpctl.tensor as dpt
-from ._kde_sycl_ext import _kde
+import dpctl.utils as du
+from . import _kde_sycl_ext
+from ._kde_sycl_ext import (
+    _kde, _kde_host_inputs, _loo_log_likelihood, _rff_update, _rff_evaluate, _kde_accumulate, _kde_from_sums,
+    _kde_ragged, _warmup,
+)
+from ._telemetry import Telemetry
+from ._validation import _validate_inputs
 
 
-def _validate_inputs(poi, sample, h, expected_type):
+def _kde_dpctl_chunk_sizes(m, n, d, itemsize, memory_budget):
     """
-    Returns (poi.shape[0], samples.shape[0], poi.shape[1], h)
+    Returns (m_chunk, n_chunk), so that temporaries of evaluating
+    density estimate for `m_chunk` points of interest over `n_chunk`
+    sample points fit in `memory_budget` bytes.
     """
-    if not isinstance(poi, expected_type):
-        raise TypeError(
-            f"Expected first argument of type {expected_type}, got {type(poi)}"
-        )
-    if not isinstance(sample, expected_type):
-        raise TypeError(
-            f"Expected second argument of type {expected_type}, got {type(sample)}"
-        )
-    if not (sample.ndim == 2 and poi.ndim == 2):
-        raise ValueError("Both input arrays must be two-dimensional")
-    h = float(h)
-    if not (h > 0):
-        raise ValueError("KDE smoothing scale must be positive")
-    m, d1 = poi.shape
-    n, d2 = sample.shape
-    if not (d1 == d2):
-        raise ValueError(f"Dimensionality of inputs must be the same, but got {d1} and {d2}")
-    return m, n, d1, h
+    # bytes per (poi, sample) pair held in temporaries: (m, n, d) arrays of
+    # differences and their squares, (m, n) arrays of distances, scaled
+    # distances and their exponents
+    pair_nbytes = (2 * d + 3) * itemsize
+    max_pairs = max(1, memory_budget // pair_nbytes)
+    m_chunk = min(m, max_pairs)
+    n_chunk = min(n, max(1, max_pairs // m_chunk))
+    return m_chunk, n_chunk
 
 
-def kde_dpctl(poi: dpt.usm_ndarray, sample: dpt.usm_ndarray, h: float) -> dpt.usm_ndarray:
+def kde_dpctl(poi: dpt.usm_ndarray, sample: dpt.usm_ndarray, h: float, memory_budget=None) -> dpt.usm_ndarray:
     """Given a sample from underlying continuous distribution and
     a smoothing parameter `h`, evaluate density estimate at points of
     interest `poi`.
+
+    The sample is processed in chunks, so that temporaries do not
+    exceed `memory_budget` bytes, which defaults to 1/8 of global memory
+    of the device.
     """
     m, n, d, h = _validate_inputs(poi, sample, h, dpt.usm_ndarray)
     xp = poi.__array_namespace__()
-    dm = xp.sum(xp.square(poi[:, xp.newaxis, ...] - sample[xp.newaxis, ...]), axis=-1)
-    assert dm.shape == (m, n)
+    if memory_budget is None:
+        memory_budget = poi.sycl_device.global_mem_size // 8
+    m_chunk, n_chunk = _kde_dpctl_chunk_sizes(m, n, d, poi.itemsize, memory_budget)
+
+    sums = xp.empty((m,), dtype=poi.dtype, usm_type=poi.usm_type, device=poi.device)
+    for i0 in range(0, m, m_chunk):
+        poi_chunk = poi[i0:i0 + m_chunk]
+        partial_sums = xp.zeros(poi_chunk.shape[:1], dtype=poi.dtype, usm_type=poi.usm_type, device=poi.device)
+        for j0 in range(0, n, n_chunk):
+            sample_chunk = sample[j0:j0 + n_chunk]
+            dm = xp.sum(xp.square(poi_chunk[:, xp.newaxis, ...] - sample_chunk[xp.newaxis, ...]), axis=-1)
+            assert dm.shape == (poi_chunk.shape[0], sample_chunk.shape[0])
+            partial_sums += xp.sum(xp.exp(dm/(-2*h*h)), axis=-1)
+        sums[i0:i0 + m_chunk] = partial_sums
+
     two_pi = dpt.asarray(2*xp.pi, dtype=poi.dtype, device=poi.device)
-    return xp.mean(xp.exp(dm/(-2*h*h)), axis=-1) * xp.pow(xp.sqrt(two_pi) * h, -d)
+    return (sums / n) * xp.pow(xp.sqrt(two_pi) * h, -d)
+
+
+def _as_array(x):
+    """
+    Returns usm_ndarray, or numpy.ndarray, sharing memory with `x` whenever
+    possible: arrays of these types are returned as is, producers of
+    `__sycl_usm_array_interface__` or DLPack capsules are viewed.
+    """
+    if isinstance(x, (dpt.usm_ndarray, np.ndarray)):
+        return x
+    if hasattr(x, "__sycl_usm_array_interface__"):
+        return dpt.asarray(x)
+    if hasattr(x, "__dlpack__"):
+        try:
+            return dpt.from_dlpack(x)
+        except (BufferError, ValueError, TypeError):
+            # content of the producer is in host memory
+            return np.from_dlpack(x)
+    return np.asarray(x)
+
+
+def _as_bandwidth(h, d, dtype, sycl_queue):
+    """
+    Returns scalar smoothing parameter `h` as float. Bandwidth given as
+    array of per-dimension smoothing parameters, shape (d,), is returned
+    as usm_ndarray, and bandwidth matrix H, shape (d, d), is returned as
+    usm_ndarray with its lower-triangular Cholesky factor L, H = L @ L.T.
+    """
+    if isinstance(h, dpt.usm_ndarray):
+        h = dpt.asnumpy(h)
+    h = np.asarray(h, dtype=dtype)
+    if h.ndim == 0:
+        h = float(h)
+        if not (h > 0):
+            raise ValueError("KDE smoothing scale must be positive")
+        return h
+    if h.shape == (d,):
+        if not np.all(h > 0):
+            raise ValueError("KDE smoothing scales must be positive")
+        bw = h
+    elif h.shape == (d, d):
+        if not np.allclose(h, h.T):
+            raise ValueError("Bandwidth matrix must be symmetric")
+        try:
+            bw = np.linalg.cholesky(h)
+        except np.linalg.LinAlgError:
+            raise ValueError("Bandwidth matrix must be positive definite") from None
+    else:
+        raise ValueError(
+            f"Bandwidth must be a scalar, or have shape {(d,)} or {(d, d)}, got shape {h.shape}"
+        )
+    return dpt.asarray(np.ascontiguousarray(bw, dtype=dtype), sycl_queue=sycl_queue)
 
 
-def kde_ext(poi: dpt.usm_ndarray, sample: dpt.usm_ndarray, h: float, mode=0) -> dpt.usm_ndarray:
+# kernel function selectors of _kde and _kde_host_inputs
+_kernel_ids = {
+    "gaussian": 0,
+    "epanechnikov": 1,
+    "tricube": 2,
+    "uniform": 3,
+}
+
+
+def _as_weights(weights, n, dtype, sycl_queue):
+    """
+    Returns weights of sample points as usm_ndarray of shape (n,) on
+    `sycl_queue`. Weights must be non-negative with a positive sum, which
+    normalizes the estimate, so checking them waits for their values.
+    """
+    weights = _as_array(weights)
+    if weights.shape != (n,):
+        raise ValueError(
+            f"Weights must have shape {(n,)}, got shape {weights.shape}"
+        )
+    xp = np if isinstance(weights, np.ndarray) else dpt
+    if bool(xp.any(weights < 0)):
+        raise ValueError("Weights must be non-negative")
+    if not bool(xp.sum(weights) > 0):
+        raise ValueError("Sum of weights must be positive")
+    return dpt.asarray(weights, dtype=dtype, order="C", sycl_queue=sycl_queue)
+
+
+def kde_ext(poi, sample, h, mode=0, out=None, device=None, weights=None, kernel="gaussian") -> dpt.usm_ndarray:
     """Given a sample from underlying continuous distribution and
     a smoothing parameter `h`, evaluate density estimate at points of
     interest `poi`.
+
+    Smoothing parameter `h` is a positive scalar, an array of shape (d,)
+    of per-dimension smoothing parameters, or a symmetric positive
+    definite bandwidth matrix of shape (d, d), for Gaussian kernel
+    exp(-x^T H^{-1} x / 2). For the latter two, kernels scale differences
+    of points by the inverse of the Cholesky factor of H, so that neither
+    points of interest nor the sample are transformed.
+
+    Optional non-negative `weights` of sample points, of shape (n,), scale
+    contributions of respective points, and the estimate is normalized by
+    the sum of weights, e.g. counts of deduplicated points, or importance
+    weights. ValueError is raised for negative weights, or a zero sum.
+
+    Kernel function is selected by name `kernel`: "gaussian" (default),
+    or one of kernels with compact support "epanechnikov", "tricube",
+    "uniform", which vanish at distances from sample points exceeding `h`.
+
+    Implementation is selected by `mode`: 0 - work-group reduction with
+    atomic updates, 1 - atomic updates, 2 - reduction over temporaries,
+    3 - reduction over temporaries with its submissions recorded into
+    a SYCL command graph, which is cached by shapes and data type and
+    replayed by later calls, also for different arrays and smoothing
+    parameters. Mode 3 submits eagerly if command graphs
+    are not supported, and behaves as mode 2 if `weights` are given.
+
+    Inputs can be usm_ndarray, NumPy arrays, or objects supporting
+    `__sycl_usm_array_interface__` or DLPack protocols, which are used
+    without copying. If the sample is in host memory, devices able to
+    access host memory, e.g. CPU devices, read it in place, and it is
+    only copied for devices which can not. The execution device is that
+    of `poi` or `out` if they are usm_ndarray, and `device` otherwise.
+
+    The computation is submitted asynchronously, ordered after tasks
+    previously submitted to the execution queue by dpctl.tensor. If `out`
+    is provided, estimates are written into it, and it is returned.
     """
-    _, _, _, h = _validate_inputs(poi, sample, h, dpt.usm_ndarray)
+    if kernel not in _kernel_ids:
+        raise ValueError(
+            f"Unsupported kernel {kernel!r}, expected one of {list(_kernel_ids)}"
+        )
+    poi = _as_array(poi)
+    sample = _as_array(sample)
+    m, n, d, _ = _validate_inputs(poi, sample, None, (dpt.usm_ndarray, np.ndarray))
 
-    xp = poi.__array_namespace__()
-    pdf = xp.empty_like(poi[:, 0])
-    # Returns host-task event, and event associated with offloaded tasks
-    ht_ev, impl_ev = _kde(poi=poi, sample=sample, pdf=pdf, h=h, mode=mode, depends=[])
+    host_inputs = isinstance(sample, np.ndarray)
+    if host_inputs:
+        if isinstance(poi, dpt.usm_ndarray):
+            exec_q = poi.sycl_queue
+            usm_type = poi.usm_type
+        elif out is not None:
+            exec_q = out.sycl_queue
+            usm_type = out.usm_type
+        else:
+            exec_q = dpt.Device.create_device(device).sycl_queue
+            usm_type = "device"
+        dt = sample.dtype
+        if isinstance(poi, dpt.usm_ndarray):
+            # points of interest stay on the device, kernels read them in place
+            poi = dpt.asarray(poi, dtype=dt, order="C")
+        else:
+            poi = np.ascontiguousarray(poi, dtype=dt)
+        sample = np.ascontiguousarray(sample)
+    else:
+        if isinstance(poi, np.ndarray):
+            poi = dpt.asarray(poi, dtype=sample.dtype, sycl_queue=sample.sycl_queue)
+        exec_q = poi.sycl_queue
+        usm_type = poi.usm_type
+        dt = poi.dtype
+
+    h = _as_bandwidth(h, d, dt, exec_q)
 
-    # wait for the events
-    ht_ev.wait()
-    impl_ev.wait()
+    if weights is not None:
+        weights = _as_weights(weights, n, dt, exec_q)
+
+    if out is None:
+        pdf = dpt.empty((m,), dtype=dt, usm_type=usm_type, sycl_queue=exec_q)
+    else:
+        if not isinstance(out, dpt.usm_ndarray):
+            raise TypeError(
+                f"Expected output array of type {dpt.usm_ndarray}, got {type(out)}"
+            )
+        if out.shape != (m,) or out.dtype != dt:
+            raise ValueError(
+                f"Output array must have shape {(m,)} and dtype {dt}, "
+                f"got shape {out.shape} and dtype {out.dtype}"
+            )
+        pdf = out
+
+    impl_fn = _kde_host_inputs if host_inputs else _kde
+
+    # either synchronize, or get dependencies and pass them
+    # to _kde via depends = list_of_events
+    if hasattr(du, "SequentialOrderManager"):
+        _mgr = du.SequentialOrderManager[exec_q]
+        deps = _mgr.submitted_events
+        # Returns host-task event, and event associated with offloaded tasks
+        ht_ev, impl_ev = impl_fn(poi=poi, sample=sample, pdf=pdf, h=h, mode=mode, depends=deps, weights=weights, kernel=_kernel_ids[kernel])
+        _mgr.add_event_pair(ht_ev, impl_ev)
+    else:
+        exec_q.wait()
+        ht_ev, _ = impl_fn(poi=poi, sample=sample, pdf=pdf, h=h, mode=mode, depends=[], weights=weights, kernel=_kernel_ids[kernel])
+        ht_ev.wait()
 
     return pdf
 
 
-def kde_numpy(poi: np.ndarray, sample: np.ndarray, h: float) -> np.ndarray:
-    """Given a sample from underlying continuous distribution and
-    a smoothing parameter `h`, evaluate density estimate at each point of
-    interest `poi`.
+def warmup(queue=None) -> int:
+    """
+    Build device code of the extension for the device of `queue`, a
+    SyclQueue or a device specifier accepted by dpctl.tensor, ahead of
+    first use. Otherwise the first call of every KDE variant pays for JIT
+    compilation of its kernels.
+
+    Returns the number of kernels built, 0 if the device image of the
+    extension is not compatible with the device.
+    """
+    exec_q = dpt.Device.create_device(queue).sycl_queue
+    return _warmup(sycl_queue=exec_q)
+
+
+# calls are named after functions of the extension module, e.g. "kde" for
+# `kde_ext` of a sample on the device, "kde_host_inputs" of a host sample
+telemetry = Telemetry(_kde_sycl_ext)
+
+
+class BandwidthSelectionResult(NamedTuple):
+    h: float
+    log_likelihood: dpt.usm_ndarray
+
+
+def select_bandwidth(sample: dpt.usm_ndarray, h_grid) -> BandwidthSelectionResult:
+    """Select smoothing parameter among candidates `h_grid`, maximizing
+    leave-one-out log-likelihood of `sample`.
+
+    Returns the selected smoothing parameter, and log-likelihood values
+    for all candidates. Raises ValueError if log-likelihood is -inf for
+    all candidates, i.e. they are too small for kernels centered at other
+    sample points to reach some points, so that none can be selected.
+    """
+    if not isinstance(sample, dpt.usm_ndarray):
+        raise TypeError(
+            f"Expected sample of type {dpt.usm_ndarray}, got {type(sample)}"
+        )
+    if sample.ndim != 2 or sample.shape[0] < 2:
+        raise ValueError("Sample must be two-dimensional, with at least two points")
+    exec_q = sample.sycl_queue
+    h_grid = dpt.asarray(h_grid, dtype=sample.dtype, usm_type=sample.usm_type, sycl_queue=exec_q)
+    if h_grid.ndim != 1 or h_grid.size == 0:
+        raise ValueError("Grid of smoothing parameters must be a non-empty one-dimensional array")
+    if not bool(dpt.all(h_grid > 0)):
+        raise ValueError("KDE smoothing scales must be positive")
+    sample = dpt.asarray(sample, order="C")
+    ll = dpt.empty(h_grid.shape, dtype=sample.dtype, usm_type=sample.usm_type, sycl_queue=exec_q)
+
+    if hasattr(du, "SequentialOrderManager"):
+        _mgr = du.SequentialOrderManager[exec_q]
+        deps = _mgr.submitted_events
+        ht_ev, impl_ev = _loo_log_likelihood(sample=sample, h_grid=h_grid, log_likelihood=ll, depends=deps)
+        _mgr.add_event_pair(ht_ev, impl_ev)
+    else:
+        exec_q.wait()
+        ht_ev, _ = _loo_log_likelihood(sample=sample, h_grid=h_grid, log_likelihood=ll, depends=[])
+        ht_ev.wait()
+
+    if not bool(dpt.any(dpt.isfinite(ll))):
+        raise ValueError(
+            "Leave-one-out log-likelihood is not finite for any candidate smoothing parameter, "
+            "candidates are too small for the sample"
+        )
+    best_id = int(dpt.argmax(ll))
+    return BandwidthSelectionResult(float(h_grid[best_id]), ll)
+
+
+def _submit_ordered(exec_q, impl_fn, **kwargs):
+    """
+    Submits `impl_fn` ordered after tasks previously submitted to `exec_q`
+    by dpctl.tensor, or synchronizes if SequentialOrderManager is not
+    available.
+    """
+    if hasattr(du, "SequentialOrderManager"):
+        _mgr = du.SequentialOrderManager[exec_q]
+        deps = _mgr.submitted_events
+        ht_ev, impl_ev = impl_fn(depends=deps, **kwargs)
+        _mgr.add_event_pair(ht_ev, impl_ev)
+    else:
+        exec_q.wait()
+        ht_ev, _ = impl_fn(depends=[], **kwargs)
+        ht_ev.wait()
+
+
+def _as_group_offsets(offsets, n_rows, name):
+    offsets = np.ascontiguousarray(offsets, dtype=np.int64)
+    if offsets.ndim != 1 or offsets.size == 0:
+        raise ValueError(f"Offsets of {name} must be a non-empty one-dimensional array")
+    if offsets[0] != 0 or offsets[-1] != n_rows or np.any(np.diff(offsets) < 0):
+        raise ValueError(
+            f"Offsets of {name} must be non-decreasing, start with 0 and end with {n_rows}"
+        )
+    return offsets
+
+
+def kde_ragged(poi, poi_offsets, sample, sample_offsets, h, out=None, kernel="gaussian") -> dpt.usm_ndarray:
+    """
+    Evaluate independent density estimates of a ragged batch of groups
+    with a single kernel launch.
+
+    Group `g` estimates density of points `sample[sample_offsets[g]:sample_offsets[g+1]]`
+    with smoothing parameter `h[g]` at points `poi[poi_offsets[g]:poi_offsets[g+1]]`.
+    Offsets are host arrays of length n_groups + 1, and `h` is a scalar, or
+    an array of shape (n_groups,). Density at points of interest of groups
+    without sample points is zero.
+
+    Work is balanced across groups in proportion to their m*n cost, so
+    that many small estimates are not dominated by launch overhead.
+
+    Example:
+        pdf = kde_ragged(poi, [0, 10, 30], sample, [0, 1000, 1500], h=[0.1, 0.2])
+    """
+    if kernel not in _kernel_ids:
+        raise ValueError(
+            f"Unsupported kernel {kernel!r}, expected one of {list(_kernel_ids)}"
+        )
+    sample = _as_array(sample)
+    if isinstance(sample, np.ndarray):
+        sample = dpt.asarray(sample)
+    sample = dpt.asarray(sample, order="C")
+    exec_q = sample.sycl_queue
+    poi = dpt.asarray(
+        _as_array(poi), dtype=sample.dtype, order="C", usm_type=sample.usm_type, sycl_queue=exec_q
+    )
+    if poi.ndim != 2 or sample.ndim != 2 or poi.shape[1] != sample.shape[1]:
+        raise ValueError(
+            "Points of interest and sample must be two-dimensional arrays with the same number of columns"
+        )
+    poi_offsets = _as_group_offsets(poi_offsets, poi.shape[0], "points of interest")
+    sample_offsets = _as_group_offsets(sample_offsets, sample.shape[0], "sample")
+    n_groups = poi_offsets.size - 1
+    if sample_offsets.size != n_groups + 1:
+        raise ValueError(
+            f"Offsets of sample must have {n_groups + 1} elements, got {sample_offsets.size}"
+        )
+    h = np.broadcast_to(np.asarray(h, dtype=np.float64), (n_groups,))
+    if not np.all(h > 0):
+        raise ValueError("KDE smoothing scales must be positive")
+    m = poi.shape[0]
+    if out is None:
+        out = dpt.empty((m,), dtype=sample.dtype, usm_type=sample.usm_type, sycl_queue=exec_q)
+    elif out.shape != (m,) or out.dtype != sample.dtype:
+        raise ValueError(
+            f"Output array must have shape {(m,)} and dtype {sample.dtype}, "
+            f"got shape {out.shape} and dtype {out.dtype}"
+        )
+    _submit_ordered(
+        exec_q, _kde_ragged,
+        poi=poi, poi_offsets=poi_offsets, sample=sample, sample_offsets=sample_offsets,
+        h=np.ascontiguousarray(h), pdf=out, kernel=_kernel_ids[kernel],
+    )
+    return out
+
+
+class RandomFourierKDE:
+    """
+    Approximate Gaussian KDE with smoothing parameter `h`, based on
+    `n_features` random Fourier features.
+
+    A single pass over the sample accumulates sums of its features on
+    the device, and evaluating the estimate at a point then costs
+    O(n_features * d) operations, independently of the sample size.
+    The sketch is updated in place as new samples arrive. The error of
+    approximation decreases as 1/sqrt(n_features).
+
+    Example:
+        est = RandomFourierKDE(d=64, h=0.5, n_features=4096)
+        for batch in batches:
+            est.update(batch)
+        pdf = est(poi)
     """
-    _, _, d, h = _validate_inputs(poi, sample, h, np.ndarray)
-    dm = np.sum(np.square(poi[:, np.newaxis, ...] - sample[np.newaxis, ...]), axis=-1)
-    return np.mean(np.exp(dm/(-2*h*h)), axis=-1)/np.power(np.sqrt(2*np.pi) * h, d)
+    def __init__(self, d, h, n_features=1024, dtype="f4", device=None, seed=None):
+        h = float(h)
+        if not (h > 0):
+            raise ValueError("KDE smoothing scale must be positive")
+        if d < 1 or n_features < 1:
+            raise ValueError("Dimensionality and number of features must be positive")
+        # allocate zero-sized array to normalize dtype and device
+        proto = dpt.empty((0,), dtype=dtype, device=device)
+        self._sycl_queue = proto.sycl_queue
+        self._dtype = proto.dtype
+        self._d = d
+        self._h = h
+        rng = np.random.default_rng(seed)
+        self._omega = dpt.asarray(
+            rng.standard_normal((n_features, d)).astype(self._dtype), sycl_queue=self._sycl_queue
+        )
+        self._offset = dpt.asarray(
+            rng.uniform(0, 2 * np.pi, n_features).astype(self._dtype), sycl_queue=self._sycl_queue
+        )
+        self._feature_sums = dpt.zeros((n_features,), dtype=self._dtype, sycl_queue=self._sycl_queue)
+        self._n_samples = 0
+
+    @property
+    def n_features(self):
+        return self._omega.shape[0]
+
+    @property
+    def n_samples(self):
+        """Number of sample points summarized by the sketch"""
+        return self._n_samples
+
+    @property
+    def sycl_queue(self):
+        return self._sycl_queue
+
+    def update(self, sample):
+        """
+        Add points of `sample`, an array of shape (n, d), to the sketch.
+        """
+        sample = dpt.asarray(_as_array(sample), dtype=self._dtype, order="C", sycl_queue=self._sycl_queue)
+        if sample.ndim != 2 or sample.shape[1] != self._d:
+            raise ValueError(
+                f"Sample must have shape (n, {self._d}), got shape {sample.shape}"
+            )
+        if sample.shape[0] == 0:
+            return self
+        _submit_ordered(
+            self._sycl_queue, _rff_update,
+            sample=sample, omega=self._omega, offset=self._offset, h=self._h,
+            feature_sums=self._feature_sums,
+        )
+        self._n_samples += sample.shape[0]
+        return self
+
+    def __call__(self, poi, out=None) -> dpt.usm_ndarray:
+        """
+        Evaluate approximate density estimate at points of interest `poi`,
+        an array of shape (m, d).
+        """
+        if self._n_samples == 0:
+            raise ValueError("Sketch is empty, call update with sample points first")
+        poi = dpt.asarray(_as_array(poi), dtype=self._dtype, order="C", sycl_queue=self._sycl_queue)
+        if poi.ndim != 2 or poi.shape[1] != self._d:
+            raise ValueError(
+                f"Points of interest must have shape (m, {self._d}), got shape {poi.shape}"
+            )
+        m = poi.shape[0]
+        if out is None:
+            out = dpt.empty((m,), dtype=self._dtype, sycl_queue=self._sycl_queue)
+        elif out.shape != (m,) or out.dtype != self._dtype:
+            raise ValueError(
+                f"Output array must have shape {(m,)} and dtype {self._dtype}, "
+                f"got shape {out.shape} and dtype {out.dtype}"
+            )
+        _submit_ordered(
+            self._sycl_queue, _rff_evaluate,
+            poi=poi, omega=self._omega, offset=self._offset, h=self._h,
+            feature_sums=self._feature_sums, n_data=self._n_samples, pdf=out,
+        )
+        return out
+
+
+class StreamingKDE:
+    """
+    KDE at fixed points of interest `poi`, updated as sample batches
+    arrive.
+
+    Unnormalized kernel sums for every point of interest are kept on the
+    device. Adding a batch of `k` points costs O(m * k) work, rather than
+    recomputing the estimate from all samples, and the estimate is only
+    normalized when it is read with `density`.
+
+    If `window` is given, oldest batches are subtracted from the sums, and
+    released, while more than `window` samples remain, so the estimate is
+    over a sliding window of batches. Since repeated subtraction accumulates
+    rounding errors, call `refresh` periodically to recompute sums from
+    retained batches.
+
+    Example:
+        est = StreamingKDE(grid, h=0.1, window=10000)
+        for batch in stream:
+            pdf = est.add(batch).density()
+    """
+    def __init__(self, poi, h, kernel="gaussian", window=None):
+        h = float(h)
+        if not (h > 0):
+            raise ValueError("KDE smoothing scale must be positive")
+        if kernel not in _kernel_ids:
+            raise ValueError(
+                f"Unsupported kernel {kernel!r}, expected one of {list(_kernel_ids)}"
+            )
+        if window is not None and window < 1:
+            raise ValueError(f"Window must be positive, got {window}")
+        poi = _as_array(poi)
+        if isinstance(poi, np.ndarray):
+            poi = dpt.asarray(poi)
+        poi = dpt.asarray(poi, order="C")
+        if poi.ndim != 2:
+            raise ValueError("Points of interest must be a two-dimensional array")
+        self._poi = poi
+        self._h = h
+        self._kernel = kernel
+        self._window = window
+        self._sums = dpt.zeros(poi.shape[:1], dtype=poi.dtype, usm_type=poi.usm_type, sycl_queue=poi.sycl_queue)
+        self._batches = deque()
+        self._n_samples = 0
+
+    @property
+    def n_samples(self):
+        """Number of sample points the estimate is over"""
+        return self._n_samples
+
+    @property
+    def sycl_queue(self):
+        return self._poi.sycl_queue
+
+    def _accumulate(self, batch, sign):
+        _submit_ordered(
+            self._poi.sycl_queue, _kde_accumulate,
+            poi=self._poi, sample=batch, h=self._h, sums=self._sums,
+            sign=sign, kernel=_kernel_ids[self._kernel],
+        )
+
+    def add(self, sample):
+        """
+        Add points of `sample`, an array of shape (k, d), to the estimate.
+        """
+        poi = self._poi
+        batch = dpt.asarray(
+            _as_array(sample), dtype=poi.dtype, order="C", usm_type=poi.usm_type, sycl_queue=poi.sycl_queue
+        )
+        if batch.ndim != 2 or batch.shape[1] != poi.shape[1]:
+            raise ValueError(
+                f"Sample must have shape (k, {poi.shape[1]}), got shape {batch.shape}"
+            )
+        if batch.shape[0] == 0:
+            return self
+        self._accumulate(batch, 1)
+        self._n_samples += batch.shape[0]
+        if self._window is None:
+            return self
+        self._batches.append(batch)
+        while self._n_samples > self._window and len(self._batches) > 1:
+            expired = self._batches.popleft()
+            self._accumulate(expired, -1)
+            self._n_samples -= expired.shape[0]
+        return self
+
+    def refresh(self):
+        """
+        Recompute kernel sums from batches in the window, discarding
+        rounding errors accumulated by subtracting expired batches.
+        """
+        if self._window is None:
+            return self
+        self._sums[...] = 0
+        for batch in self._batches:
+            self._accumulate(batch, 1)
+        return self
+
+    def density(self, out=None) -> dpt.usm_ndarray:
+        """
+        Returns density estimate at points of interest.
+        """
+        if self._n_samples == 0:
+            raise ValueError("Estimate is empty, call add with sample points first")
+        m = self._sums.shape[0]
+        if out is None:
+            out = dpt.empty_like(self._sums)
+        elif out.shape != (m,) or out.dtype != self._sums.dtype:
+            raise ValueError(
+                f"Output array must have shape {(m,)} and dtype {self._sums.dtype}, "
+                f"got shape {out.shape} and dtype {out.dtype}"
+            )
+        _submit_ordered(
+            self._poi.sycl_queue, _kde_from_sums,
+            sums=self._sums, dim=self._poi.shape[1], n_data=self._n_samples, h=self._h,
+            pdf=out, kernel=_kernel_ids[self._kernel],
+        )
+        return out
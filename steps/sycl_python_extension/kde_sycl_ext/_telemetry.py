@@ -0,0 +1,75 @@
+# Telemetry of calls of an extension module. A copy of this file is kept
+# in mkl_interface_ext, so that the QR step builds on its own.
+
+from typing import NamedTuple
+
+
+class CallStats(NamedTuple):
+    n_calls: int
+    n_kernel_launches: int
+    n_allocations: int
+    bytes_allocated: int
+    n_transfers: int
+    bytes_transferred: int
+    # host time in nanoseconds of phases "validation", "allocation",
+    # "submission", and "cleanup" in host tasks
+    host_ns: dict
+    # commands with profiling information, their total execution time,
+    # and the span of their execution, in nanoseconds of the device clock
+    n_device_events: int
+    device_ns: int
+    device_start_ns: int
+    device_end_ns: int
+
+
+class Telemetry:
+    """
+    Opt-in telemetry of calls of the extension module `ext`, accumulated
+    per call name: host time spent validating arguments, allocating
+    temporaries, submitting commands, and releasing temporaries in host
+    tasks, bytes allocated and copied between host and device, and the
+    number of launches of kernels and of library routines. A replay of a
+    command graph counts as a single launch.
+
+    Device execution times are recorded for commands submitted to queues
+    created with profiling enabled, e.g.
+    `dpctl.SyclQueue(property="enable_profiling")`.
+
+    Example:
+        with telemetry:
+            pdf = kde_ext(poi, sample, h)
+        print(telemetry.stats()["kde"].host_ns)
+    """
+    def __init__(self, ext):
+        self._ext = ext
+
+    def enable(self):
+        self._ext._telemetry_enable(enabled=True)
+
+    def disable(self):
+        self._ext._telemetry_enable(enabled=False)
+
+    @property
+    def enabled(self):
+        return self._ext._telemetry_is_enabled()
+
+    def reset(self):
+        """
+        Discard counters recorded so far. Release of temporaries by calls
+        submitted before the reset is not recorded.
+        """
+        self._ext._telemetry_reset()
+
+    def stats(self) -> dict:
+        """
+        Returns counters keyed by call name. Waits for profiled commands
+        to complete.
+        """
+        return {name: CallStats(**entry) for name, entry in self._ext._telemetry_stats().items()}
+
+    def __enter__(self):
+        self.enable()
+        return self
+
+    def __exit__(self, *exc):
+        self.disable()
@@ -0,0 +1,25 @@
+def _validate_inputs(poi, sample, h, expected_type):
+    """
+    Returns (poi.shape[0], samples.shape[0], poi.shape[1], h)
+
+    Smoothing parameter is not validated if `h` is None.
+    """
+    if not isinstance(poi, expected_type):
+        raise TypeError(
+            f"Expected first argument of type {expected_type}, got {type(poi)}"
+        )
+    if not isinstance(sample, expected_type):
+        raise TypeError(
+            f"Expected second argument of type {expected_type}, got {type(sample)}"
+        )
+    if not (sample.ndim == 2 and poi.ndim == 2):
+        raise ValueError("Both input arrays must be two-dimensional")
+    if h is not None:
+        h = float(h)
+        if not (h > 0):
+            raise ValueError("KDE smoothing scale must be positive")
+    m, d1 = poi.shape
+    n, d2 = sample.shape
+    if not (d1 == d2):
+        raise ValueError(f"Dimensionality of inputs must be the same, but got {d1} and {d2}")
+    return m, n, d1, h
@@ -2,7 +2,37 @@ import kde_sycl_ext as kse
 import dpctl
 import dpctl.tensor as dpt
 import numpy as np
+import math
+import os
+import subprocess
+import sys
 import timeit
+from concurrent.futures import ThreadPoolExecutor
+
+
+def kde_compact_numpy(poi, sample, h, kernel):
+    """
+    NumPy reference of KDE with a kernel function with compact support,
+    normalized by quadrature of its radial profile over the unit ball.
+    """
+    profiles = {
+        "epanechnikov": lambda u: 1 - u,
+        "tricube": lambda u: (1 - u ** 1.5) ** 3,
+        "uniform": lambda u: np.ones_like(u),
+    }
+    profile = profiles[kernel]
+    d = poi.shape[1]
+    # integral of K(|x|^2) over the unit ball, d * V_d * int_0^1 K(r^2) r^(d-1) dr
+    r = (np.arange(100_000) + 0.5) / 100_000
+    unit_ball_volume = math.pi ** (d / 2) / math.gamma(d / 2 + 1)
+    integral = d * unit_ball_volume * np.mean(profile(r * r) * r ** (d - 1))
+
+    poi = poi.astype(np.float64)
+    sample = sample.astype(np.float64)
+    u = np.sum(np.square(poi[:, np.newaxis, :] - sample[np.newaxis, :, :]), axis=-1) / (h * h)
+    k = np.where(u < 1, profile(np.minimum(u, 1)), 0)
+    return np.mean(k, axis=-1) / (integral * h ** d)
+
 
 print(f"Using device {dpctl.select_default_device().name}")
 
@@ -21,6 +51,49 @@ us_np = rng.uniform(0, 1, size=(n_sample, n_dim)).astype(dt, copy=False)
 poi = dpt.asarray(poi_np)
 us = dpt.asarray(us_np)
 
+# first-call latency, measured in fresh processes where device code of the
+# extension is not built yet: the first call either pays for JIT compilation
+# of its kernels (cold), or follows warmup(), which builds them ahead of time.
+# Persistent cache of device code is disabled, so that it does not hide JIT.
+first_call_script = """
+import sys, timeit
+import kde_sycl_ext as kse
+import dpctl.tensor as dpt
+
+poi = dpt.ones((1, 7), dtype="f4")
+us = dpt.ones((1, 7), dtype="f4")
+poi.sycl_queue.wait()
+
+if sys.argv[1:] == ["warmup"]:
+    t0 = timeit.default_timer()
+    n_kernels = kse.warmup(poi.sycl_queue)
+    print(n_kernels, timeit.default_timer() - t0)
+
+t0 = timeit.default_timer()
+kse.kde_ext(poi, us, 0.05).sycl_queue.wait()
+print(timeit.default_timer() - t0)
+"""
+
+
+def first_call_latency(*args):
+    res = subprocess.run(
+        [sys.executable, "-c", first_call_script, *args],
+        env=dict(os.environ, SYCL_CACHE_PERSISTENT="0"),
+        cwd=os.path.dirname(os.path.abspath(__file__)),
+        capture_output=True, text=True, check=True,
+    )
+    return [float(v) for v in res.stdout.split()]
+
+
+t_cold, = first_call_latency()
+n_kernels, t_warmup, t_warm = first_call_latency("warmup")
+
+print(f"warmup built {int(n_kernels)} kernels in {t_warmup} seconds")
+print(f"first kde_ext call latency: cold {t_cold} seconds, after warmup {t_warm} seconds")
+
+# exclude JIT compilation from timings below
+kse.warmup(poi.sycl_queue)
+
 t0 = timeit.default_timer()
 
 f1 = kse.kde_dpctl(poi, us, 0.05)
@@ -46,18 +119,198 @@ f4.sycl_queue.wait()
 
 t4 = timeit.default_timer()
 
+# tree reduction replayed from command graph, recorded by the first call
+f8 = kse.kde_ext(poi, us, h, mode=3)
+f8.sycl_queue.wait()
+
+t8 = timeit.default_timer()
+
+f8 = kse.kde_ext(poi, us, h, mode=3, out=f8)
+f8.sycl_queue.wait()
+
+t9 = timeit.default_timer()
+
 f5 = kse.kde_numpy(poi_np, us_np, h)
 
 t5 = timeit.default_timer()
 
+# host implementation, not using SYCL
+f6 = kse.kde_host(poi_np, us_np, h)
+
+t6 = timeit.default_timer()
+
+# NumPy inputs, read in place by devices which can access host memory
+f7 = kse.kde_ext(poi_np, us_np, h, mode=0, device=poi.device)
+f7.sycl_queue.wait()
+
+t7 = timeit.default_timer()
+
+# points of interest on the device, sample in host memory
+f11 = kse.kde_ext(poi, us_np, h, mode=0)
+
+# concurrent calls from several threads on a shared queue, calls of
+# mode 3 replay the same command graph
+with ThreadPoolExecutor(max_workers=4) as executor:
+    f_threads = list(
+        executor.map(lambda mode: kse.kde_ext(poi, us, h, mode=mode), [0, 1, 2, 3, 3, 3, 3, 3])
+    )
+poi.sycl_queue.wait()
+
+t10 = timeit.default_timer()
+
+# ragged batch of groups, including groups without points of interest or
+# without sample points, with per-group smoothing parameters
+poi_sizes = [5, 0, 7, 3, 1]
+sample_sizes = [2000, 500, 0, 30000, 1]
+h_groups = np.asarray([0.05, 0.1, 0.2, 0.08, 0.3])
+poi_offsets = np.concatenate(([0], np.cumsum(poi_sizes)))
+sample_offsets = np.concatenate(([0], np.cumsum(sample_sizes)))
+poi_groups = dpt.asarray(rng.uniform(0.1, 0.9, size=(poi_offsets[-1], n_dim)).astype(dt, copy=False))
+us_groups = us[:sample_offsets[-1]]
+
+for kernel in ["gaussian", "epanechnikov"]:
+    f_ragged = kse.kde_ragged(poi_groups, poi_offsets, us_groups, sample_offsets, h_groups, kernel=kernel)
+    for g in range(len(poi_sizes)):
+        f_g = f_ragged[poi_offsets[g]:poi_offsets[g + 1]]
+        if sample_sizes[g] == 0:
+            assert dpt.all(f_g == 0)
+        elif poi_sizes[g] > 0:
+            ref_g = kse.kde_ext(
+                poi_groups[poi_offsets[g]:poi_offsets[g + 1]],
+                us_groups[sample_offsets[g]:sample_offsets[g + 1]],
+                float(h_groups[g]),
+                kernel=kernel,
+            )
+            assert dpt.allclose(f_g, ref_g)
+
+# weighted sample: counts of deduplicated points weigh them as repeated
+# points, zero counts drop them
+h_w = 0.2
+uniq_np = us_np[:2000]
+counts_np = rng.integers(0, 5, size=uniq_np.shape[0])
+uniq = dpt.asarray(uniq_np)
+counts = dpt.asarray(counts_np)
+f_repeated = kse.kde_ext(poi, np.repeat(uniq_np, counts_np, axis=0), h_w)
+for mode in [0, 1, 2, 3]:
+    assert dpt.allclose(kse.kde_ext(poi, uniq, h_w, mode=mode, weights=counts), f_repeated)
+assert dpt.allclose(kse.kde_ext(poi, uniq_np, h_w, weights=counts_np), f_repeated)
+
+# anisotropic bandwidth: per-dimension smoothing parameters scale
+# coordinates, bandwidth matrix H = L L^T is applied by whitening points
+# with L^{-1}, and the estimate is normalized by det(L)
+us_aniso_np = us_np[:20000]
+us_aniso = dpt.asarray(us_aniso_np)
+h_diag = np.linspace(0.1, 0.3, n_dim).astype(dt)
+f_diag = kse.kde_ext(poi, us_aniso, h_diag)
+f_diag_ref = kse.kde_ext(dpt.asarray(poi_np / h_diag), dpt.asarray(us_aniso_np / h_diag), 1.0) / float(np.prod(h_diag))
+assert dpt.allclose(f_diag, f_diag_ref, rtol=1e-4)
+
+a = rng.uniform(-0.1, 0.1, size=(n_dim, n_dim))
+h_mat = a @ a.T + 0.01 * np.eye(n_dim)
+l_inv = np.linalg.inv(np.linalg.cholesky(h_mat))
+f_mat_ref = kse.kde_numpy(poi_np.astype(np.float64) @ l_inv.T, us_aniso_np.astype(np.float64) @ l_inv.T, 1.0)
+f_mat_ref *= np.prod(np.diag(l_inv))
+for mode in [0, 1, 2, 3]:
+    f_mat = kse.kde_ext(poi, us_aniso, h_mat, mode=mode)
+    assert dpt.allclose(f_mat, dpt.asarray(f_mat_ref.astype(dt)), rtol=1e-4)
+
+# kernel functions with compact support against the NumPy reference
+h_c = 0.4
+us_c_np = us_np[:20000]
+us_c = dpt.asarray(us_c_np)
+for kernel in ["epanechnikov", "tricube", "uniform"]:
+    f_c_ref = dpt.asarray(kde_compact_numpy(poi_np, us_c_np, h_c, kernel).astype(dt))
+    for mode in [0, 1, 2, 3]:
+        assert dpt.allclose(kse.kde_ext(poi, us_c, h_c, mode=mode, kernel=kernel), f_c_ref, rtol=1e-4)
+    assert dpt.allclose(kse.kde_ext(poi, us_c_np, h_c, kernel=kernel), f_c_ref, rtol=1e-4)
+
+# random Fourier features approximate the Gaussian KDE, with error of
+# order 1/sqrt(n_features) relative to the peak of the kernel
+h_rff = 0.2
+poi_rff = dpt.asarray(np.ascontiguousarray(poi_np[:, :2]))
+us_rff = dpt.asarray(np.ascontiguousarray(us_np[:50000, :2]))
+rff = kse.RandomFourierKDE(2, h_rff, n_features=8192, seed=1234).update(us_rff)
+f_rff = rff(poi_rff)
+f_rff_ref = kse.kde_ext(poi_rff, us_rff, h_rff)
+assert float(dpt.max(dpt.abs(f_rff - f_rff_ref))) <= 0.1 * float(dpt.max(f_rff_ref))
+
+# sketch of two batches equals sketch of the combined batch
+rff_2 = kse.RandomFourierKDE(2, h_rff, n_features=8192, seed=1234)
+rff_2.update(us_rff[:20000]).update(us_rff[20000:])
+assert rff_2.n_samples == rff.n_samples
+assert dpt.allclose(rff_2(poi_rff), f_rff, rtol=1e-4)
+
+# streaming estimate over a sliding window retains the last two batches
+# of five, and agrees with kde_ext over them before and after refresh
+h_s = 0.4
+batches = [us[i * 5000:(i + 1) * 5000] for i in range(5)]
+for kernel in ["gaussian", "epanechnikov"]:
+    streaming = kse.StreamingKDE(poi, h_s, kernel=kernel, window=12000)
+    for batch in batches:
+        streaming.add(batch)
+    assert streaming.n_samples == 10000
+    f_s_ref = kse.kde_ext(poi, dpt.concat(batches[3:]), h_s, kernel=kernel)
+    # subtraction of expired batches leaves rounding errors of their sums
+    atol_s = 1e-3 * float(dpt.max(f_s_ref))
+    assert dpt.allclose(streaming.density(), f_s_ref, rtol=1e-3, atol=atol_s)
+    assert dpt.allclose(streaming.refresh().density(), f_s_ref, rtol=1e-4)
+
+# bandwidth selection maximizes leave-one-out log-likelihood, sum over
+# sample points of logarithms of estimates by other points
+us_loo_np = us_np[:500].astype(np.float64)
+h_grid = np.geomspace(0.1, 1.0, 12)
+d_sq = np.sum(np.square(us_loo_np[:, np.newaxis, :] - us_loo_np[np.newaxis, :, :]), axis=-1)
+# a point does not contribute to its own estimate
+np.fill_diagonal(d_sq, np.inf)
+ll_ref = np.asarray([
+    np.sum(np.log(
+        np.sum(np.exp(-d_sq / (2 * h_k * h_k)), axis=-1) / (us_loo_np.shape[0] - 1)
+        / np.power(np.sqrt(2 * np.pi) * h_k, n_dim)
+    ))
+    for h_k in h_grid
+])
+selected = kse.select_bandwidth(dpt.asarray(us_np[:500]), h_grid)
+assert np.allclose(dpt.asnumpy(selected.log_likelihood), ll_ref, rtol=1e-3)
+# candidates of nearly equal log-likelihood may be selected either way
+selected_id = np.argmin(np.abs(h_grid - selected.h))
+assert ll_ref[selected_id] >= np.max(ll_ref) - 1e-3 * np.abs(np.max(ll_ref))
+
+# candidates too small for any point to be reached by kernels of others
+try:
+    kse.select_bandwidth(dpt.asarray(us_np[:500]), [1e-4])
+except ValueError:
+    pass
+else:
+    raise AssertionError("select_bandwidth did not reject candidates with -inf log-likelihood")
+
+# kde_dpctl processes points of interest and the sample in chunks, whose
+# temporaries fit in memory_budget bytes: (2 * d + 3) * itemsize bytes per pair
+us_chunks = us[:60]
+pair_nbytes = (2 * n_dim + 3) * us.itemsize
+f_unchunked = kse.kde_dpctl(poi, us_chunks, 0.2)
+# several chunks of 10 sample points for all points of interest
+assert dpt.allclose(kse.kde_dpctl(poi, us_chunks, 0.2, memory_budget=pair_nbytes * n_est * 10), f_unchunked)
+# several chunks of 5 points of interest, one sample point at a time
+assert dpt.allclose(kse.kde_dpctl(poi, us_chunks, 0.2, memory_budget=pair_nbytes * 5), f_unchunked)
+
 assert dpt.allclose(f1, f2)
 assert dpt.allclose(f1, f3)
 assert dpt.allclose(f1, f4)
+assert dpt.allclose(f1, f8)
 assert dpt.allclose(f1, dpt.asarray(f5))
+assert dpt.allclose(f1, dpt.asarray(f6))
+assert dpt.allclose(f1, f7)
+assert dpt.allclose(f1, f11)
+for f in f_threads:
+    assert dpt.allclose(f1, f)
 
 print("Result agreed.")
 print(f"kde_dpctl took {t1-t0} seconds")
 print(f"kde_ext[mode=0] {t2-t1} seconds")
 print(f"kde_ext[mode=1] {t3-t2} seconds")
 print(f"kde_ext[mode=2] {t4-t3} seconds")
-print(f"kde_numpy {t5-t4} seconds")
+print(f"kde_ext[mode=3] recording {t8-t4} seconds, replay {t9-t8} seconds")
+print(f"kde_numpy {t5-t9} seconds")
+print(f"kde_host {t6-t5} seconds")
+print(f"kde_ext[mode=0, NumPy inputs] {t7-t6} seconds")
+print(f"kde_ext[modes 0-3, 4 threads, 8 calls] {t10-t7} seconds")
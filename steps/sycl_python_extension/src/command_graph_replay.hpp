@@ -0,0 +1 @@
+../../kernel_density_estimation_cpp/command_graph_replay.hpp
\ No newline at end of file
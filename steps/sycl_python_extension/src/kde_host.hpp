@@ -0,0 +1,324 @@
+// Copyright 2022-2024 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Host-only implementation of kernel density estimation, which does not
+// require SYCL runtime. Evaluates the same formula as
+// example::kernel_density_estimate from kde.hpp.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace example {
+
+namespace host_detail {
+
+template <typename T>
+T gaussian_density_scaling_factor(T h, std::int32_t dim)
+{
+    const T two_pi = T(8) * std::atan(T(1));
+    T gaussian_norm;
+    if (dim % 2 == 1) {
+        gaussian_norm = (T(1) / (std::sqrt(two_pi) * h)) / static_cast<T>(std::pow(two_pi * h * h, dim / 2));
+    } else {
+        gaussian_norm = T(1) / static_cast<T>(std::pow(two_pi * h * h, dim / 2));
+    }
+
+    return gaussian_norm;
+}
+
+/*
+    Pool of worker threads, created on first use by `instance()`, and
+    reused by later calls, so that calls do not spawn threads.
+
+    `run(n_tasks, fn)` calls fn(task_id) for 0 <= task_id < n_tasks, and
+    returns once all calls complete. Tasks are claimed by the calling
+    thread and by workers, so at most `n_tasks` threads work on them.
+    Concurrent calls of `run` are serialized.
+ */
+class thread_pool {
+public:
+    explicit thread_pool(unsigned int n_workers)
+    {
+        workers_.reserve(n_workers);
+        for(unsigned int i = 0; i < n_workers; ++i) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        job_cv_.notify_all();
+        for(auto &th : workers_) {
+            th.join();
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    /* Pool with a worker per hardware thread other than the calling one */
+    static thread_pool &instance()
+    {
+        static thread_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    void run(unsigned int n_tasks, const std::function<void(unsigned int)> &fn)
+    {
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn;
+            n_tasks_ = n_tasks;
+            next_task_ = 0;
+            error_ = nullptr;
+            ++generation_;
+        }
+        job_cv_.notify_all();
+
+        execute_tasks(fn, n_tasks);
+
+        std::exception_ptr error;
+        {
+            // workers which joined the job may still execute claimed tasks
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_cv_.wait(lock, [this] { return n_active_ == 0; });
+            job_ = nullptr;
+            error = error_;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void execute_tasks(const std::function<void(unsigned int)> &fn, unsigned int n_tasks)
+    {
+        for(unsigned int task_id = next_task_++; task_id < n_tasks; task_id = next_task_++) {
+            try {
+                fn(task_id);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void worker_loop()
+    {
+        std::uint64_t seen_generation = 0;
+        for(;;) {
+            const std::function<void(unsigned int)> *job;
+            unsigned int n_tasks;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                job_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+                // job may have completed before the worker woke up
+                if (!job_) {
+                    continue;
+                }
+                job = job_;
+                n_tasks = n_tasks_;
+                ++n_active_;
+            }
+
+            execute_tasks(*job, n_tasks);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --n_active_;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable job_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(unsigned int)> *job_ = nullptr;
+    unsigned int n_tasks_ = 0;
+    std::atomic<unsigned int> next_task_{0};
+    unsigned int n_active_ = 0;
+    std::uint64_t generation_ = 0;
+    std::exception_ptr error_{};
+    bool stop_ = false;
+};
+
+/*! @brief Number of sample points processed together by the inner loops */
+constexpr size_t sample_tile_size = 256;
+
+/*
+    Accumulates into sums[t], 0 <= t < n_evals, unnormalized Gaussian kernel
+    values over data points [data_begin, data_end). Sums are accumulated
+    locally, and `sums` is written once, so that threads writing adjacent
+    ranges of sums do not contend for cache lines.
+
+    Data points are transposed tile by tile into (dim, sample_tile_size)
+    layout, so that inner loops over data points of the tile use unit
+    stride, and can be vectorized by the compiler. Compile with
+    -fopenmp-simd to vectorize the reduction of kernel values.
+ */
+template <typename T>
+void accumulate_over_data_range(
+    size_t n_evals,
+    std::int32_t dim,
+    const T *x_poi,
+    T *sums,
+    const T *data,
+    size_t data_begin,
+    size_t data_end,
+    T h)
+{
+    std::vector<T> tile(static_cast<size_t>(dim) * sample_tile_size);
+    std::vector<T> local_sums(n_evals, T(0));
+    T dist_sq[sample_tile_size];
+
+    const T scale = T(-1) / (T(2) * h * h);
+
+    for(size_t tile_begin = data_begin; tile_begin < data_end; tile_begin += sample_tile_size) {
+        const size_t tile_len = std::min(sample_tile_size, data_end - tile_begin);
+
+        for(size_t j = 0; j < tile_len; ++j) {
+            const T *x_data = data + (tile_begin + j) * dim;
+            for(std::int32_t k = 0; k < dim; ++k) {
+                tile[k * sample_tile_size + j] = x_data[k];
+            }
+        }
+
+        for(size_t t = 0; t < n_evals; ++t) {
+            const T *y = x_poi + t * dim;
+
+            std::fill(dist_sq, dist_sq + tile_len, T(0));
+            for(std::int32_t k = 0; k < dim; ++k) {
+                const T y_k = y[k];
+                const T *tile_k = tile.data() + k * sample_tile_size;
+                for(size_t j = 0; j < tile_len; ++j) {
+                    const T diff = y_k - tile_k[j];
+                    dist_sq[j] += diff * diff;
+                }
+            }
+
+            T local_sum(0);
+            // reduction is only vectorized if re-association is permitted
+            #pragma omp simd reduction(+:local_sum)
+            for(size_t j = 0; j < tile_len; ++j) {
+                local_sum += std::exp(dist_sq[j] * scale);
+            }
+            local_sums[t] += local_sum;
+        }
+    }
+
+    for(size_t t = 0; t < n_evals; ++t) {
+        sums[t] += local_sums[t];
+    }
+}
+
+} // namespace host_detail
+
+/*
+    Evaluates
+
+     f(x, h) = sum(
+        1/(sqrt(2*pi)*h)**dim * exp( - dist_squared(x, x_data[j])/(2*h*h)),
+        0 <= j < n_data) / n_data
+
+    on host, splitting data points into `n_threads` contiguous ranges,
+    processed concurrently by threads of host_detail::thread_pool, at most
+    one per hardware thread. If `n_threads` is zero, hardware concurrency
+    is used.
+
+    All pointers are expected to be host pointers.
+ */
+template <typename T>
+void
+kernel_density_estimate_host(
+    // number of points to evaluate
+    size_t n_evals,
+    // dimensionality of the data
+    std::int32_t dim,
+    // points at which KDE is evaluated, content of (n_evals, dims) array
+    const T* x_poi,
+    // where values of kde(x, h) are written to, content of (n_evals, ) array
+    T *f,
+    // Number of points in the data-set: sample from an unknown distribution
+    size_t n_data,
+    // data-set, content of (n_data, dims) array
+    const T* data,
+    // smoothing parameter
+    T h,
+    // number of threads to use
+    unsigned int n_threads
+)
+{
+    assert(dim > 0);
+
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // do not spawn threads which would get less than a tile of data
+    const size_t n_tiles = (n_data + host_detail::sample_tile_size - 1) / host_detail::sample_tile_size;
+    n_threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(n_threads, n_tiles)));
+
+    // partial sums of each range, combined once all ranges are processed
+    std::vector<T> partial_sums(static_cast<size_t>(n_threads) * n_evals, T(0));
+
+    const size_t tiles_per_thread = (n_tiles + n_threads - 1) / n_threads;
+    auto worker = [&](unsigned int thread_id) {
+        const size_t data_begin = std::min(n_data, thread_id * tiles_per_thread * host_detail::sample_tile_size);
+        const size_t data_end = std::min(n_data, data_begin + tiles_per_thread * host_detail::sample_tile_size);
+
+        host_detail::accumulate_over_data_range<T>(
+            n_evals, dim, x_poi, partial_sums.data() + thread_id * n_evals, data, data_begin, data_end, h);
+    };
+
+    if (n_threads == 1) {
+        worker(0);
+    } else {
+        host_detail::thread_pool::instance().run(n_threads, worker);
+    }
+
+    const T gaussian_norm = host_detail::gaussian_density_scaling_factor(h, dim);
+    for(size_t t = 0; t < n_evals; ++t) {
+        T sum(0);
+        for(unsigned int thread_id = 0; thread_id < n_threads; ++thread_id) {
+            sum += partial_sums[thread_id * n_evals + t];
+        }
+        f[t] = (gaussian_norm / n_data) * sum;
+    }
+}
+
+} // namespace example
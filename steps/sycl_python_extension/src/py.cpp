@@ -1,10 +1,22 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include "dpctl4pybind11.hpp"
 
 #include "utils/type_dispatch.hpp"
 #include "kde.hpp"
+#include "telemetry.hpp"
+#include "telemetry_pybind.hpp"
 
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -13,15 +25,59 @@ namespace dpt = dpctl::tensor;
 
 typedef std::intptr_t ssize_t;
 
+// names of kernels identifying device images of this module, which are
+// split by optional device features used by kernels, fp64 and 64-bit atomics
+template <typename T> class kde_ext_warmup_krn;
+template <typename T> class kde_ext_warmup_atomic_krn;
+
 const auto &unexpected_shape_msg = "Unexpected shapes of array arguments";
 const auto &unexpected_types_msg = "Unexpected types of array arguments: expected arrays of the same real floating type";
 const auto &unexpected_layout_msg = "All input arrays must be C-contiguous";
 const auto &incompatible_queue_msg = "Unable to deduce execution queue, queues associated with input arrays are not the same";
 const auto &expected_writable_msg = "Output array must be writable";
+const auto &unexpected_bandwidth_msg = "Bandwidth array must be C-contiguous, have the type of other arrays, and shape (dim,) for per-dimension smoothing parameters or (dim, dim) for Cholesky factor of bandwidth matrix";
+const auto &unexpected_offsets_msg = "Offsets of groups must be one-dimensional arrays with one more element than the number of groups, non-decreasing, starting with zero and ending with the number of rows";
+const auto &unexpected_host_types_msg = "Unexpected types of array arguments: expected host arrays of the same real floating type as output array";
 
-template <typename T>
-sycl::event 
-call_kde(
+struct kde_graph_key {
+    sycl::context ctx;
+    sycl::device dev;
+    size_t m;
+    size_t dim;
+    size_t n;
+
+    bool operator==(const kde_graph_key &other) const {
+        return (ctx == other.ctx) && (dev == other.dev) &&
+            (m == other.m) && (dim == other.dim) && (n == other.n);
+    }
+};
+
+struct kde_graph_key_hash {
+    std::size_t operator()(const kde_graph_key &key) const {
+        std::size_t seed = std::hash<sycl::context>{}(key.ctx);
+        seed ^= std::hash<sycl::device>{}(key.dev) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<size_t>{}(key.m) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<size_t>{}(key.dim) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<size_t>{}(key.n) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+// number of command graphs of mode 3 kept per data type and kernel function
+constexpr size_t max_cached_kde_graphs = 8;
+
+/*
+    Temps implementation replayed from a command graph, see
+    example::kernel_density_estimate_temps_graph. Graphs are cached by
+    shape of inputs, and per data type and kernel function, since the
+    cache is a static of the function template. The cache keeps the
+    `max_cached_kde_graphs` most recently used graphs, so that their
+    temporaries do not accumulate. Calls with the same key are
+    serialized, since they share temporaries of the graph.
+ */
+template <typename T, typename KernelT>
+sycl::event
+call_kde_temps_graph(
     sycl::queue &exec_q,
     size_t m,
     size_t dim,
@@ -30,24 +86,287 @@ call_kde(
     size_t n,
     const T* sample_ptr,
     T h,
+    const std::vector<sycl::event> &depends
+)
+{
+    using graph_t = example::kernel_density_estimate_temps_graph<T, KernelT>;
+
+    struct cache_entry {
+        std::mutex mutex;
+        std::unique_ptr<graph_t> graph;
+    };
+    // entries in order of use, most recent first, and their index
+    using lru_list_t = std::list<std::pair<kde_graph_key, std::shared_ptr<cache_entry>>>;
+    using index_t = std::unordered_map<kde_graph_key, typename lru_list_t::iterator, kde_graph_key_hash>;
+
+    static std::mutex cache_mutex;
+    // intentionally leaked, so that device allocations of graphs are not
+    // freed after the SYCL runtime is torn down at interpreter exit
+    static auto *lru = new lru_list_t{};
+    static auto *index = new index_t{};
+
+    const kde_graph_key key{exec_q.get_context(), exec_q.get_device(), m, dim, n};
+
+    // evicted entry is destroyed, waiting for its last call, once
+    // neither the cache lock nor other callers hold it
+    std::shared_ptr<cache_entry> evicted{};
+    std::shared_ptr<cache_entry> entry{};
+    {
+        std::lock_guard<std::mutex> lock{cache_mutex};
+        auto it = index->find(key);
+        if (it != index->end()) {
+            lru->splice(lru->begin(), *lru, it->second);
+        } else {
+            auto new_entry = std::make_shared<cache_entry>();
+            new_entry->graph = std::make_unique<graph_t>(exec_q, m, dim, n);
+            lru->emplace_front(key, std::move(new_entry));
+            (*index)[key] = lru->begin();
+
+            if (lru->size() > max_cached_kde_graphs) {
+                evicted = std::move(lru->back().second);
+                index->erase(lru->back().first);
+                lru->pop_back();
+            }
+        }
+        entry = lru->front().second;
+    }
+
+    std::lock_guard<std::mutex> lock{entry->mutex};
+    return (*entry->graph)(exec_q, poi_ptr, pdf_ptr, sample_ptr, h, depends);
+}
+
+/*
+    Dispatches on implementation `mode`. The data-set is weighted
+    unless `weights` is nullptr. Smoothing parameter `h` is either
+    scalar, or example::bandwidth_factor<T>. Mode 3, temps implementation
+    replayed from a command graph, falls back to mode 2 for weighted
+    data-sets, and for anisotropic bandwidths.
+ */
+template <typename T, typename KernelT, typename BandwidthT>
+sycl::event 
+call_kde_impl(
+    sycl::queue &exec_q,
+    size_t m,
+    size_t dim,
+    const T* poi_ptr,
+    T *pdf_ptr,
+    size_t n,
+    const T* sample_ptr,
+    const T* weights_ptr,
+    const BandwidthT &h,
     int mode,
     const std::vector<sycl::event> &depends
 )
 {
+    if (weights_ptr) {
+        if (mode == 0) {
+            return example::kernel_density_estimate_work_group_reduce_and_atomic_ref<T, KernelT>(
+                exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, h, depends);
+        } else if (mode == 1) {
+            return example::kernel_density_estimate_atomic_ref<T, KernelT>(
+                exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, h, depends);
+        } else if (mode == 2 || mode == 3) {
+            return example::kernel_density_estimate_temps<T, KernelT>(
+                exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, h, depends);
+        } else {
+            throw std::runtime_error("Invalid mode parameter");
+        }
+    }
+
     if (mode == 0) {
-        return example::kernel_density_estimate_work_group_reduce_and_atomic_ref<T>(
+        return example::kernel_density_estimate_work_group_reduce_and_atomic_ref<T, KernelT>(
             exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, h, depends);
     } else if (mode == 1) {
-        return example::kernel_density_estimate_atomic_ref<T>(
+        return example::kernel_density_estimate_atomic_ref<T, KernelT>(
             exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, h, depends);
     } else if (mode == 2) {
-        return example::kernel_density_estimate_temps<T>(
+        return example::kernel_density_estimate_temps<T, KernelT>(
             exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, h, depends);
+    } else if (mode == 3) {
+        if constexpr (std::is_same_v<BandwidthT, T>) {
+            return call_kde_temps_graph<T, KernelT>(
+                exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, h, depends);
+        } else {
+            return example::kernel_density_estimate_temps<T, KernelT>(
+                exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, h, depends);
+        }
     } else {
         throw std::runtime_error("Invalid mode parameter");
     }
 }
 
+/*
+    Calls `fn` with an instance of kernel function policy selected by
+    `kernel`: 0 - Gaussian, 1 - Epanechnikov, 2 - tricube, 3 - uniform.
+    Selectors are validated by callers holding the GIL, the exception
+    thrown for others does not access Python objects.
+ */
+template <typename FnT>
+sycl::event
+dispatch_kernel_function(int kernel, FnT &&fn)
+{
+    if (kernel == 0) {
+        return fn(example::gaussian_kernel{});
+    } else if (kernel == 1) {
+        return fn(example::epanechnikov_kernel{});
+    } else if (kernel == 2) {
+        return fn(example::tricube_kernel{});
+    } else if (kernel == 3) {
+        return fn(example::uniform_kernel{});
+    } else {
+        throw py::value_error("Supported kernel selector values are 0, 1, 2, 3");
+    }
+}
+
+/* Dispatches on kernel function selector, see dispatch_kernel_function */
+template <typename T, typename BandwidthT>
+sycl::event 
+call_kde(
+    sycl::queue &exec_q,
+    size_t m,
+    size_t dim,
+    const T* poi_ptr,
+    T *pdf_ptr,
+    size_t n,
+    const T* sample_ptr,
+    const T* weights_ptr,
+    const BandwidthT &h,
+    int mode,
+    int kernel,
+    const std::vector<sycl::event> &depends
+)
+{
+    return dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+        using KernelT = decltype(kernel_fn);
+        return call_kde_impl<T, KernelT>(
+            exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, h, mode, depends);
+    });
+}
+
+/*
+    Validates weights of sample points given as usm_ndarray of shape (n,).
+    Their values, non-negative with a positive sum, are checked by kde_ext,
+    since reading them would block on tasks computing them.
+ */
+void
+validate_weights_array(
+    const dpt::usm_ndarray &weights,
+    ssize_t n,
+    int typenum,
+    const sycl::queue &exec_q
+)
+{
+    if (weights.get_ndim() != 1 || weights.get_shape(0) != n) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    if (weights.get_typenum() != typenum) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!weights.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {weights.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+}
+
+template <typename T>
+const T *
+get_weights_ptr(const py::object &weights)
+{
+    return (weights.is_none()) ? nullptr : py::cast<dpt::usm_ndarray>(weights).get_data<T>();
+}
+
+/*
+    Returns pointer to bandwidth array `h`, or nullptr if `h` is a Python
+    scalar, written to `h_sc`.
+ */
+template <typename T>
+const T *
+get_bandwidth_ptr(const py::object &h, T &h_sc)
+{
+    if (py::isinstance<dpt::usm_ndarray>(h)) {
+        h_sc = T(0);
+        return py::cast<dpt::usm_ndarray>(h).get_data<T>();
+    }
+
+    h_sc = py::cast<T>(h);
+    return nullptr;
+}
+
+/*
+    Validates bandwidth given as usm_ndarray, and returns whether it represents
+    per-dimension smoothing parameters, shape (dim,), as opposed to Cholesky
+    factor of bandwidth matrix, shape (dim, dim).
+ */
+bool
+validate_bandwidth_array(
+    const dpt::usm_ndarray &bw,
+    ssize_t dim,
+    int typenum,
+    const sycl::queue &exec_q
+)
+{
+    const int bw_ndim = bw.get_ndim();
+    bool valid_shape = (bw_ndim == 1 || bw_ndim == 2);
+    for(int i = 0; valid_shape && i < bw_ndim; ++i) {
+        valid_shape = (bw.get_shape(i) == dim);
+    }
+
+    if (!valid_shape || bw.get_typenum() != typenum || !bw.is_c_contiguous()) {
+        throw py::value_error(unexpected_bandwidth_msg);
+    }
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {bw.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    return (bw_ndim == 1);
+}
+
+/*
+    Dispatches on smoothing parameter: scalar `h`, unless `bw_ptr` points
+    to a bandwidth array validated with `validate_bandwidth_array`.
+
+    Python objects are not accessed, so the GIL need not be held.
+ */
+template <typename T>
+sycl::event
+call_kde_with_bandwidth(
+    sycl::queue &exec_q,
+    size_t m,
+    size_t dim,
+    const T* poi_ptr,
+    T *pdf_ptr,
+    size_t n,
+    const T* sample_ptr,
+    const T* weights_ptr,
+    const T* bw_ptr,
+    T h,
+    bool is_diagonal,
+    int mode,
+    int kernel,
+    const std::vector<sycl::event> &depends
+)
+{
+    if (!bw_ptr) {
+        return call_kde<T>(exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, h, mode, kernel, depends);
+    }
+
+    auto anisotropic_impl =
+        [weights_ptr, mode, kernel](sycl::queue &q, size_t m_, std::int32_t dim_, const T *x, T *f, size_t n_, const T *data,
+               const example::bandwidth_factor<T> &bw, const std::vector<sycl::event> &deps)
+        {
+            return call_kde<T>(q, m_, dim_, x, f, n_, data, weights_ptr, bw, mode, kernel, deps);
+        };
+
+    return example::kernel_density_estimate_anisotropic<T>(
+        exec_q, m, dim, poi_ptr, pdf_ptr, n, sample_ptr, bw_ptr, is_diagonal, anisotropic_impl, depends);
+}
+
 std::pair<sycl::event, sycl::event>
 py_kde_ext(
     const dpt::usm_ndarray &poi,
@@ -55,8 +374,12 @@ py_kde_ext(
     py::object h,
     const dpt::usm_ndarray &pdf,
     int mode,
-    const std::vector<sycl::event> &depends
+    const std::vector<sycl::event> &depends,
+    py::object weights,
+    int kernel
 ) {
+    example::telemetry::call_scope telemetry_call{"kde"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
 
     if (poi.get_ndim() != 2 || sample.get_ndim() != 2 || pdf.get_ndim() != 1) {
         throw py::value_error(unexpected_shape_msg);
@@ -100,10 +423,25 @@ py_kde_ext(
 
     sycl::queue &exec_q = q_poi;
 
-    if (mode < 0 || mode > 2) {
-        throw py::value_error("Supported mode selector values are 0, 1, 2");
+    if (mode < 0 || mode > 3) {
+        throw py::value_error("Supported mode selector values are 0, 1, 2, 3");
+    }
+
+    if (kernel < 0 || kernel > 3) {
+        throw py::value_error("Supported kernel selector values are 0, 1, 2, 3");
+    }
+
+    bool is_diagonal = false;
+    if (py::isinstance<dpt::usm_ndarray>(h)) {
+        is_diagonal = validate_bandwidth_array(py::cast<dpt::usm_ndarray>(h), d1, poi_tn, exec_q);
     }
 
+    if (!weights.is_none()) {
+        validate_weights_array(py::cast<dpt::usm_ndarray>(weights), n, poi_tn, exec_q);
+    }
+
+    validation.stop();
+
     auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
     int inp_typeid = array_types.typenum_to_lookup_id(poi_tn);
 
@@ -111,38 +449,1154 @@ py_kde_ext(
     if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
         using T = float;
 
-        T h_sc = py::cast<T>(h);
-        e_comp = 
-            call_kde<T>(exec_q, m, d1, poi.get_data<T>(), pdf.get_data<T>(), n, sample.get_data<T>(), h_sc, mode, depends);
+        T h_sc;
+        const T *bw_ptr = get_bandwidth_ptr<T>(h, h_sc);
+        const T *poi_ptr = poi.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+        const T *weights_ptr = get_weights_ptr<T>(weights);
+
+        py::gil_scoped_release release;
+        e_comp =
+            call_kde_with_bandwidth<T>(
+                exec_q, m, d1, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, bw_ptr, h_sc, is_diagonal, mode, kernel, depends);
 
     } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
         using T = double;
 
-        T h_sc = py::cast<T>(h);
-        e_comp = 
-            call_kde<T>(exec_q, m, d1, poi.get_data<T>(), pdf.get_data<T>(), n, sample.get_data<T>(), h_sc, mode, depends);
+        T h_sc;
+        const T *bw_ptr = get_bandwidth_ptr<T>(h, h_sc);
+        const T *poi_ptr = poi.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+        const T *weights_ptr = get_weights_ptr<T>(weights);
+
+        py::gil_scoped_release release;
+        e_comp =
+            call_kde_with_bandwidth<T>(
+                exec_q, m, d1, poi_ptr, pdf_ptr, n, sample_ptr, weights_ptr, bw_ptr, h_sc, is_diagonal, mode, kernel, depends);
 
     } else {
         throw py::value_error(unexpected_types_msg);
     }
 
     sycl::event ht_ev = 
-        dpctl::utils::keep_args_alive(exec_q, {poi, sample, pdf}, {e_comp});
+        dpctl::utils::keep_args_alive(exec_q, {poi, sample, pdf, h, weights}, {e_comp});
 
     return std::make_pair(ht_ev, e_comp);
 }
 
 
-PYBIND11_MODULE(_kde_sycl_ext, m) {
-    m.def(
-        "_kde", 
-        py_kde_ext, 
-        "Kernel density estimation",
-        py::arg("poi"),
-        py::arg("sample"),
-        py::arg("h"),
-        py::arg("pdf"),
-        py::arg("mode"),
-        py::arg("depends")
+/*
+    Returns pointer to points of interest given by usm_ndarray if
+    `on_device`, and by a host array otherwise.
+ */
+template <typename T>
+const T *
+get_poi_ptr(const py::object &poi, bool on_device)
+{
+    return (on_device) ? py::cast<dpt::usm_ndarray>(poi).get_data<T>()
+                       : static_cast<const T *>(py::cast<py::array>(poi).data());
+}
+
+/*
+    Content of a host array, represented by a pointer which kernels submitted
+    to a queue can dereference.
+
+    Devices with `usm_system_allocations` aspect, such as CPU devices, access
+    host memory in place. For other devices the content is copied into
+    a temporary device allocation, which is owned by this object.
+ */
+template <typename T>
+struct host_input {
+    const T *ptr = nullptr;
+    T *owned = nullptr;
+    sycl::event copy_ev{};
+
+    // frees the owned copy on failure of a call, once its copying completes
+    void release(sycl::queue &exec_q) {
+        if (owned) {
+            copy_ev.wait();
+            sycl::free(owned, exec_q);
+            owned = nullptr;
+        }
+    }
+};
+
+template <typename T>
+host_input<T>
+make_host_input(sycl::queue &exec_q, const T *host_ptr, size_t n_elems, const std::vector<sycl::event> &depends)
+{
+    host_input<T> inp;
+    if (exec_q.get_device().has(sycl::aspect::usm_system_allocations)) {
+        inp.ptr = host_ptr;
+        return inp;
+    }
+
+    T *dev_ptr = example::telemetry::malloc_device<T>(n_elems, exec_q);
+    if (!dev_ptr) {
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    inp.ptr = dev_ptr;
+    inp.owned = dev_ptr;
+    inp.copy_ev = exec_q.copy<T>(host_ptr, dev_ptr, n_elems, depends);
+    example::telemetry::record_transfer(exec_q, inp.copy_ev, n_elems * sizeof(T));
+
+    return inp;
+}
+
+/*
+    Points of interest are read in place if `poi_on_device`, otherwise they
+    are a host array, treated as the sample.
+ */
+template <typename T>
+sycl::event
+call_kde_host_inputs(
+    sycl::queue &exec_q,
+    size_t m,
+    size_t dim,
+    const T *poi_ptr,
+    bool poi_on_device,
+    size_t n,
+    const T *sample_host_ptr,
+    const T *weights_ptr,
+    const T *bw_ptr,
+    T h,
+    bool is_diagonal,
+    T *pdf_ptr,
+    int mode,
+    int kernel,
+    const std::vector<sycl::event> &depends
+)
+{
+    host_input<T> poi_inp;
+    if (poi_on_device) {
+        poi_inp.ptr = poi_ptr;
+    } else {
+        poi_inp = make_host_input<T>(exec_q, poi_ptr, m * dim, depends);
+    }
+
+    host_input<T> sample_inp;
+    try {
+        sample_inp = make_host_input<T>(exec_q, sample_host_ptr, n * dim, depends);
+    } catch (const std::exception &e) {
+        poi_inp.release(exec_q);
+        throw;
+    }
+
+    std::vector<sycl::event> kde_depends(depends);
+    kde_depends.push_back(poi_inp.copy_ev);
+    kde_depends.push_back(sample_inp.copy_ev);
+
+    sycl::event e_comp;
+    try {
+        e_comp =
+            call_kde_with_bandwidth<T>(
+                exec_q, m, dim, poi_inp.ptr, pdf_ptr, n, sample_inp.ptr, weights_ptr, bw_ptr, h, is_diagonal, mode, kernel, kde_depends);
+    } catch (const std::exception &e) {
+        // e.g. allocation of temporaries failed, after kernels reading
+        // copies of inputs may have been submitted
+        if (poi_inp.owned || sample_inp.owned) {
+            exec_q.wait();
+        }
+        poi_inp.release(exec_q);
+        sample_inp.release(exec_q);
+        throw;
+    }
+
+    if (!poi_inp.owned && !sample_inp.owned) {
+        return e_comp;
+    }
+
+    sycl::event e_free =
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(e_comp);
+
+            const auto ctx = exec_q.get_context();
+            T *poi_owned = poi_inp.owned;
+            T *sample_owned = sample_inp.owned;
+            cgh.host_task([ctx, poi_owned, sample_owned, call = example::telemetry::current_cleanup()] {
+                example::telemetry::cleanup_scope cleanup{call};
+                if (poi_owned) sycl::free(poi_owned, ctx);
+                if (sample_owned) sycl::free(sample_owned, ctx);
+            });
+        });
+
+    return e_free;
+}
+
+/*
+    Same as py_kde_ext, but the sample is given by a host array, e.g. NumPy
+    array, and is used without copying whenever execution device can access
+    host memory. Points of interest are given either by a host array, used
+    as the sample, or by usm_ndarray, which kernels read on the device.
+ */
+std::pair<sycl::event, sycl::event>
+py_kde_ext_host_inputs(
+    const py::object &poi,
+    const py::array &sample,
+    py::object h,
+    const dpt::usm_ndarray &pdf,
+    int mode,
+    const std::vector<sycl::event> &depends,
+    py::object weights,
+    int kernel
+) {
+    example::telemetry::call_scope telemetry_call{"kde_host_inputs"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    const bool poi_on_device = py::isinstance<dpt::usm_ndarray>(poi);
+
+    int poi_ndim;
+    ssize_t m, d1;
+    int poi_tn;
+    bool poi_c_contig;
+    if (poi_on_device) {
+        auto poi_arr = py::cast<dpt::usm_ndarray>(poi);
+        poi_ndim = poi_arr.get_ndim();
+        m = (poi_ndim == 2) ? poi_arr.get_shape(0) : 0;
+        d1 = (poi_ndim == 2) ? poi_arr.get_shape(1) : 0;
+        poi_tn = poi_arr.get_typenum();
+        poi_c_contig = poi_arr.is_c_contiguous();
+    } else {
+        auto poi_arr = py::cast<py::array>(poi);
+        poi_ndim = poi_arr.ndim();
+        m = (poi_ndim == 2) ? poi_arr.shape(0) : 0;
+        d1 = (poi_ndim == 2) ? poi_arr.shape(1) : 0;
+        poi_tn = poi_arr.dtype().num();
+        poi_c_contig = (poi_arr.flags() & py::array::c_style);
+    }
+
+    if (poi_ndim != 2 || sample.ndim() != 2 || pdf.get_ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t n = sample.shape(0);
+    ssize_t d2 = sample.shape(1);
+
+    ssize_t pdf_len = pdf.get_shape(0);
+
+    if ((d1 != d2) || (pdf_len != m)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    int pdf_tn = pdf.get_typenum();
+
+    if ((poi_tn != pdf_tn) || (sample.dtype().num() != pdf_tn)) {
+        throw py::value_error(unexpected_host_types_msg);
+    }
+
+    if (!poi_c_contig || !(sample.flags() & py::array::c_style) || !pdf.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!pdf.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = pdf.get_queue();
+
+    if (poi_on_device &&
+        !dpctl::utils::queues_are_compatible(exec_q, {py::cast<dpt::usm_ndarray>(poi).get_queue()}))
+    {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    if (mode < 0 || mode > 3) {
+        throw py::value_error("Supported mode selector values are 0, 1, 2, 3");
+    }
+
+    if (kernel < 0 || kernel > 3) {
+        throw py::value_error("Supported kernel selector values are 0, 1, 2, 3");
+    }
+
+    bool is_diagonal = false;
+    if (py::isinstance<dpt::usm_ndarray>(h)) {
+        is_diagonal = validate_bandwidth_array(py::cast<dpt::usm_ndarray>(h), d1, pdf_tn, exec_q);
+    }
+
+    if (!weights.is_none()) {
+        validate_weights_array(py::cast<dpt::usm_ndarray>(weights), n, pdf_tn, exec_q);
+    }
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(pdf_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        T h_sc;
+        const T *bw_ptr = get_bandwidth_ptr<T>(h, h_sc);
+        const T *poi_ptr = get_poi_ptr<T>(poi, poi_on_device);
+        const T *sample_ptr = static_cast<const T *>(sample.data());
+        const T *weights_ptr = get_weights_ptr<T>(weights);
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            call_kde_host_inputs<T>(
+                exec_q, m, d1, poi_ptr, poi_on_device, n, sample_ptr, weights_ptr, bw_ptr, h_sc, is_diagonal, pdf_ptr, mode, kernel, depends);
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        T h_sc;
+        const T *bw_ptr = get_bandwidth_ptr<T>(h, h_sc);
+        const T *poi_ptr = get_poi_ptr<T>(poi, poi_on_device);
+        const T *sample_ptr = static_cast<const T *>(sample.data());
+        const T *weights_ptr = get_weights_ptr<T>(weights);
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            call_kde_host_inputs<T>(
+                exec_q, m, d1, poi_ptr, poi_on_device, n, sample_ptr, weights_ptr, bw_ptr, h_sc, is_diagonal, pdf_ptr, mode, kernel, depends);
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    // host arrays must outlive kernels reading them in place
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {poi, sample, pdf, h, weights}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+
+/*
+    Evaluates leave-one-out log-likelihood of the sample for each candidate
+    smoothing parameter in `h_grid`.
+ */
+std::pair<sycl::event, sycl::event>
+py_loo_log_likelihood(
+    const dpt::usm_ndarray &sample,
+    const dpt::usm_ndarray &h_grid,
+    const dpt::usm_ndarray &log_likelihood,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"loo_log_likelihood"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (sample.get_ndim() != 2 || h_grid.get_ndim() != 1 || log_likelihood.get_ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t n = sample.get_shape(0);
+    ssize_t d = sample.get_shape(1);
+    ssize_t n_h = h_grid.get_shape(0);
+
+    if ((n < 2) || (log_likelihood.get_shape(0) != n_h)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    int sample_tn = sample.get_typenum();
+    int h_grid_tn = h_grid.get_typenum();
+    int ll_tn = log_likelihood.get_typenum();
+
+    if ((sample_tn != h_grid_tn) || (sample_tn != ll_tn)) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!sample.is_c_contiguous() || !h_grid.is_c_contiguous() || !log_likelihood.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!log_likelihood.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue q_sample = sample.get_queue();
+    sycl::queue q_h_grid = h_grid.get_queue();
+    sycl::queue q_ll = log_likelihood.get_queue();
+
+    if (!dpctl::utils::queues_are_compatible(q_sample, {q_h_grid, q_ll})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    sycl::queue &exec_q = q_sample;
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(sample_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        const T *sample_ptr = sample.get_data<T>();
+        const T *h_grid_ptr = h_grid.get_data<T>();
+        T *ll_ptr = log_likelihood.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::leave_one_out_log_likelihood<T>(
+                exec_q, n, d, sample_ptr, n_h, h_grid_ptr, ll_ptr, depends);
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        const T *sample_ptr = sample.get_data<T>();
+        const T *h_grid_ptr = h_grid.get_data<T>();
+        T *ll_ptr = log_likelihood.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::leave_one_out_log_likelihood<T>(
+                exec_q, n, d, sample_ptr, n_h, h_grid_ptr, ll_ptr, depends);
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {sample, h_grid, log_likelihood}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+/*
+    Validates random frequencies, phases and feature sums of random Fourier
+    features sketch, and returns the number of features.
+ */
+ssize_t
+validate_random_features(
+    const dpt::usm_ndarray &omega,
+    const dpt::usm_ndarray &offset,
+    const dpt::usm_ndarray &feature_sums,
+    ssize_t dim,
+    int typenum,
+    const sycl::queue &exec_q
+)
+{
+    if (omega.get_ndim() != 2 || offset.get_ndim() != 1 || feature_sums.get_ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t n_features = omega.get_shape(0);
+    if ((omega.get_shape(1) != dim) || (offset.get_shape(0) != n_features) || (feature_sums.get_shape(0) != n_features)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    if ((omega.get_typenum() != typenum) || (offset.get_typenum() != typenum) || (feature_sums.get_typenum() != typenum)) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!omega.is_c_contiguous() || !offset.is_c_contiguous() || !feature_sums.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {omega.get_queue(), offset.get_queue(), feature_sums.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    return n_features;
+}
+
+/*
+    Accumulates random Fourier features of the sample batch into
+    `feature_sums`.
+ */
+std::pair<sycl::event, sycl::event>
+py_rff_update(
+    const dpt::usm_ndarray &sample,
+    const dpt::usm_ndarray &omega,
+    const dpt::usm_ndarray &offset,
+    py::object h,
+    const dpt::usm_ndarray &feature_sums,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"rff_update"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (sample.get_ndim() != 2) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t n = sample.get_shape(0);
+    ssize_t d = sample.get_shape(1);
+
+    int sample_tn = sample.get_typenum();
+
+    if (!sample.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!feature_sums.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = sample.get_queue();
+
+    ssize_t n_features = validate_random_features(omega, offset, feature_sums, d, sample_tn, exec_q);
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(sample_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        T h_sc = py::cast<T>(h);
+        const T *sample_ptr = sample.get_data<T>();
+        const T *omega_ptr = omega.get_data<T>();
+        const T *offset_ptr = offset.get_data<T>();
+        T *feature_sums_ptr = feature_sums.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::random_fourier_features_update<T>(
+                exec_q, n, d, sample_ptr, n_features, omega_ptr, offset_ptr, h_sc, feature_sums_ptr, depends);
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        T h_sc = py::cast<T>(h);
+        const T *sample_ptr = sample.get_data<T>();
+        const T *omega_ptr = omega.get_data<T>();
+        const T *offset_ptr = offset.get_data<T>();
+        T *feature_sums_ptr = feature_sums.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::random_fourier_features_update<T>(
+                exec_q, n, d, sample_ptr, n_features, omega_ptr, offset_ptr, h_sc, feature_sums_ptr, depends);
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {sample, omega, offset, feature_sums}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+/*
+    Evaluates approximate KDE at points of interest from random Fourier
+    features sketch of `n_data` sample points.
+ */
+std::pair<sycl::event, sycl::event>
+py_rff_evaluate(
+    const dpt::usm_ndarray &poi,
+    const dpt::usm_ndarray &omega,
+    const dpt::usm_ndarray &offset,
+    py::object h,
+    const dpt::usm_ndarray &feature_sums,
+    size_t n_data,
+    const dpt::usm_ndarray &pdf,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"rff_evaluate"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (poi.get_ndim() != 2 || pdf.get_ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t m = poi.get_shape(0);
+    ssize_t d = poi.get_shape(1);
+
+    if ((pdf.get_shape(0) != m) || (n_data == 0)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    int poi_tn = poi.get_typenum();
+
+    if (pdf.get_typenum() != poi_tn) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!poi.is_c_contiguous() || !pdf.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!pdf.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = poi.get_queue();
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {pdf.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    ssize_t n_features = validate_random_features(omega, offset, feature_sums, d, poi_tn, exec_q);
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(poi_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = poi.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+        const T *omega_ptr = omega.get_data<T>();
+        const T *offset_ptr = offset.get_data<T>();
+        const T *feature_sums_ptr = feature_sums.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::random_fourier_features_evaluate<T>(
+                exec_q, m, d, poi_ptr, pdf_ptr, n_features, omega_ptr, offset_ptr, h_sc, feature_sums_ptr, n_data, depends);
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = poi.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+        const T *omega_ptr = omega.get_data<T>();
+        const T *offset_ptr = offset.get_data<T>();
+        const T *feature_sums_ptr = feature_sums.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp =
+            example::random_fourier_features_evaluate<T>(
+                exec_q, m, d, poi_ptr, pdf_ptr, n_features, omega_ptr, offset_ptr, h_sc, feature_sums_ptr, n_data, depends);
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {poi, omega, offset, feature_sums, pdf}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+/*
+    Adds `sign` times unnormalized kernel sums over the sample batch
+    to `sums`, for streaming updates of KDE at fixed points of interest.
+ */
+std::pair<sycl::event, sycl::event>
+py_kde_accumulate(
+    const dpt::usm_ndarray &poi,
+    const dpt::usm_ndarray &sample,
+    py::object h,
+    const dpt::usm_ndarray &sums,
+    int sign,
+    int kernel,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"kde_accumulate"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (poi.get_ndim() != 2 || sample.get_ndim() != 2 || sums.get_ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t m = poi.get_shape(0);
+    ssize_t d1 = poi.get_shape(1);
+
+    ssize_t n = sample.get_shape(0);
+    ssize_t d2 = sample.get_shape(1);
+
+    if ((d1 != d2) || (sums.get_shape(0) != m)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    int poi_tn = poi.get_typenum();
+
+    if ((sample.get_typenum() != poi_tn) || (sums.get_typenum() != poi_tn)) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!poi.is_c_contiguous() || !sample.is_c_contiguous() || !sums.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!sums.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = poi.get_queue();
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {sample.get_queue(), sums.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    if (sign != 1 && sign != -1) {
+        throw py::value_error("Supported sign values are 1, -1");
+    }
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(poi_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = poi.get_data<T>();
+        T *sums_ptr = sums.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_accumulate<T, KernelT>(
+                exec_q, m, d1, poi_ptr, sums_ptr, n, sample_ptr, h_sc, T(sign), depends);
+        });
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = poi.get_data<T>();
+        T *sums_ptr = sums.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_accumulate<T, KernelT>(
+                exec_q, m, d1, poi_ptr, sums_ptr, n, sample_ptr, h_sc, T(sign), depends);
+        });
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {poi, sample, sums}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+/*
+    Writes out KDE from unnormalized kernel sums over `n_data` sample points
+    of `dim` dimensions.
+ */
+std::pair<sycl::event, sycl::event>
+py_kde_from_sums(
+    const dpt::usm_ndarray &sums,
+    int dim,
+    size_t n_data,
+    py::object h,
+    const dpt::usm_ndarray &pdf,
+    int kernel,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"kde_from_sums"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (sums.get_ndim() != 1 || pdf.get_ndim() != 1 || (sums.get_shape(0) != pdf.get_shape(0))) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    if ((dim < 1) || (n_data == 0)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    int sums_tn = sums.get_typenum();
+
+    if (pdf.get_typenum() != sums_tn) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!sums.is_c_contiguous() || !pdf.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!pdf.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = sums.get_queue();
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {pdf.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    const size_t m = sums.get_shape(0);
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(sums_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        T h_sc = py::cast<T>(h);
+        const T *sums_ptr = sums.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_from_sums<T, KernelT>(
+                exec_q, m, dim, sums_ptr, pdf_ptr, n_data, h_sc, depends);
+        });
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        T h_sc = py::cast<T>(h);
+        const T *sums_ptr = sums.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_from_sums<T, KernelT>(
+                exec_q, m, dim, sums_ptr, pdf_ptr, n_data, h_sc, depends);
+        });
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {sums, pdf}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+using host_offsets_t = py::array_t<std::int64_t, py::array::c_style | py::array::forcecast>;
+using host_bandwidths_t = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+/*
+    Validates CSR-style offsets of `n_groups` groups of rows of an array
+    with `n_rows` rows: non-decreasing, starting with zero, and ending
+    with `n_rows`. Returns a copy of offsets.
+ */
+std::vector<std::int64_t>
+get_group_offsets(const host_offsets_t &offsets, ssize_t n_groups, ssize_t n_rows)
+{
+    if (offsets.ndim() != 1 || offsets.shape(0) != n_groups + 1) {
+        throw py::value_error(unexpected_offsets_msg);
+    }
+
+    const std::int64_t *offsets_ptr = offsets.data();
+    bool valid = (offsets_ptr[0] == 0) && (offsets_ptr[n_groups] == n_rows);
+    for(ssize_t g = 0; valid && g < n_groups; ++g) {
+        valid = (offsets_ptr[g] <= offsets_ptr[g + 1]);
+    }
+
+    if (!valid) {
+        throw py::value_error(unexpected_offsets_msg);
+    }
+
+    return std::vector<std::int64_t>(offsets_ptr, offsets_ptr + n_groups + 1);
+}
+
+/*
+    Evaluates independent density estimates of groups of rows of `sample`
+    at groups of rows of `poi`, given by CSR-style offsets, with smoothing
+    parameters `h` of groups, see example::kernel_density_estimate_ragged.
+ */
+std::pair<sycl::event, sycl::event>
+py_kde_ragged(
+    const dpt::usm_ndarray &poi,
+    const host_offsets_t &poi_offsets,
+    const dpt::usm_ndarray &sample,
+    const host_offsets_t &sample_offsets,
+    const host_bandwidths_t &h,
+    const dpt::usm_ndarray &pdf,
+    int kernel,
+    const std::vector<sycl::event> &depends
+) {
+    example::telemetry::call_scope telemetry_call{"kde_ragged"};
+    example::telemetry::phase_scope validation{example::telemetry::phase::validation};
+
+    if (poi.get_ndim() != 2 || sample.get_ndim() != 2 || pdf.get_ndim() != 1 || h.ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t m = poi.get_shape(0);
+    ssize_t d1 = poi.get_shape(1);
+
+    ssize_t n = sample.get_shape(0);
+    ssize_t d2 = sample.get_shape(1);
+
+    if ((d1 != d2) || (pdf.get_shape(0) != m)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    const ssize_t n_groups = h.shape(0);
+    std::vector<std::int64_t> poi_offsets_vec = get_group_offsets(poi_offsets, n_groups, m);
+    std::vector<std::int64_t> sample_offsets_vec = get_group_offsets(sample_offsets, n_groups, n);
+
+    int poi_tn = poi.get_typenum();
+
+    if ((sample.get_typenum() != poi_tn) || (pdf.get_typenum() != poi_tn)) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    if (!poi.is_c_contiguous() || !sample.is_c_contiguous() || !pdf.is_c_contiguous()) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!pdf.is_writable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    sycl::queue exec_q = poi.get_queue();
+
+    if (!dpctl::utils::queues_are_compatible(exec_q, {sample.get_queue(), pdf.get_queue()})) {
+        throw py::value_error(incompatible_queue_msg);
+    }
+
+    const double *h_ptr = h.data();
+
+    validation.stop();
+
+    auto const &array_types = dpt::type_dispatch::usm_ndarray_types();
+    int inp_typeid = array_types.typenum_to_lookup_id(poi_tn);
+
+    sycl::event e_comp;
+    if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::FLOAT)) {
+        using T = float;
+
+        std::vector<T> h_vec(h_ptr, h_ptr + n_groups);
+        const T *poi_ptr = poi.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_estimate_ragged<T, KernelT>(
+                exec_q, n_groups, d1, poi_ptr, poi_offsets_vec.data(), pdf_ptr,
+                sample_ptr, sample_offsets_vec.data(), h_vec.data(), depends);
+        });
+
+    } else if (inp_typeid == static_cast<int>(dpctl::tensor::type_dispatch::typenum_t::DOUBLE)) {
+        using T = double;
+
+        std::vector<T> h_vec(h_ptr, h_ptr + n_groups);
+        const T *poi_ptr = poi.get_data<T>();
+        const T *sample_ptr = sample.get_data<T>();
+        T *pdf_ptr = pdf.get_data<T>();
+
+        py::gil_scoped_release release;
+        e_comp = dispatch_kernel_function(kernel, [&](auto kernel_fn) {
+            using KernelT = decltype(kernel_fn);
+            return example::kernel_density_estimate_ragged<T, KernelT>(
+                exec_q, n_groups, d1, poi_ptr, poi_offsets_vec.data(), pdf_ptr,
+                sample_ptr, sample_offsets_vec.data(), h_vec.data(), depends);
+        });
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    sycl::event ht_ev =
+        dpctl::utils::keep_args_alive(exec_q, {poi, sample, pdf}, {e_comp});
+
+    return std::make_pair(ht_ev, e_comp);
+}
+
+/*
+    Kernel ids of warm-up kernels of type T, which use the same optional
+    device features as KDE kernels of that type: arithmetic in T, and
+    atomic updates of T. Empty if the device does not support them.
+ */
+template <typename T>
+std::vector<sycl::kernel_id>
+warmup_kernel_ids(const sycl::device &dev)
+{
+    if constexpr (std::is_same_v<T, double>) {
+        if (!dev.has(sycl::aspect::fp64)) {
+            return {};
+        }
+        if (!dev.has(sycl::aspect::atomic64)) {
+            return {sycl::get_kernel_id<kde_ext_warmup_krn<T>>()};
+        }
+    }
+
+    return {sycl::get_kernel_id<kde_ext_warmup_krn<T>>(), sycl::get_kernel_id<kde_ext_warmup_atomic_krn<T>>()};
+}
+
+template <typename T>
+void
+submit_warmup_kernels(
+    sycl::queue &exec_q,
+    const sycl::kernel_bundle<sycl::bundle_state::executable> &kb
+)
+{
+    T *tmp = sycl::malloc_device<T>(1, exec_q);
+    if (!tmp) {
+        throw std::runtime_error("Device allocation failed");
+    }
+
+    if (kb.has_kernel(sycl::get_kernel_id<kde_ext_warmup_krn<T>>())) {
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.use_kernel_bundle(kb);
+            cgh.single_task<kde_ext_warmup_krn<T>>([=]() { *tmp = T(1) / T(3); });
+        });
+    }
+
+    if (kb.has_kernel(sycl::get_kernel_id<kde_ext_warmup_atomic_krn<T>>())) {
+        exec_q.submit([&](sycl::handler &cgh) {
+            cgh.use_kernel_bundle(kb);
+            cgh.single_task<kde_ext_warmup_atomic_krn<T>>([=]() {
+                sycl::atomic_ref<T, sycl::memory_order::relaxed,
+                                 sycl::memory_scope::device,
+                                 sycl::access::address_space::global_space> v(*tmp);
+                v += T(1);
+            });
+        });
+    }
+
+    exec_q.wait();
+    sycl::free(tmp, exec_q);
+}
+
+/*
+    Builds device code of this module, i.e. all instantiations of KDE
+    kernels, for the device of `exec_q` ahead of first use, so that first
+    calls do not pay for JIT compilation. Device images of the module are
+    split by optional device features used by kernels, so every image is
+    identified by trivial kernels defined alongside other kernels of the
+    module, per data type and use of atomics. Kernels supported by the
+    device are submitted, so that built programs are cached by the runtime.
+
+    Returns the number of kernels in the built bundle.
+ */
+size_t
+py_warmup(sycl::queue &exec_q)
+{
+    py::gil_scoped_release release;
+
+    const sycl::context &ctx = exec_q.get_context();
+    const sycl::device &dev = exec_q.get_device();
+
+    std::vector<sycl::kernel_id> warmup_kids = warmup_kernel_ids<float>(dev);
+    for (const sycl::kernel_id &kid : warmup_kernel_ids<double>(dev)) {
+        warmup_kids.push_back(kid);
+    }
+
+    if (!sycl::has_kernel_bundle<sycl::bundle_state::executable>(ctx, {dev}, warmup_kids)) {
+        return 0;
+    }
+
+    auto kb = sycl::get_kernel_bundle<sycl::bundle_state::executable>(ctx, {dev}, warmup_kids);
+
+    submit_warmup_kernels<float>(exec_q, kb);
+    submit_warmup_kernels<double>(exec_q, kb);
+
+    return kb.get_kernel_ids().size();
+}
+
+PYBIND11_MODULE(_kde_sycl_ext, m) {
+    m.def(
+        "_kde", 
+        py_kde_ext, 
+        "Kernel density estimation",
+        py::arg("poi"),
+        py::arg("sample"),
+        py::arg("h"),
+        py::arg("pdf"),
+        py::arg("mode"),
+        py::arg("depends"),
+        py::arg("weights") = py::none(),
+        py::arg("kernel") = 0
+    );
+    m.def(
+        "_kde_host_inputs",
+        py_kde_ext_host_inputs,
+        "Kernel density estimation for a sample in host memory, and points of interest in host or USM memory",
+        py::arg("poi"),
+        py::arg("sample"),
+        py::arg("h"),
+        py::arg("pdf"),
+        py::arg("mode"),
+        py::arg("depends"),
+        py::arg("weights") = py::none(),
+        py::arg("kernel") = 0
+    );
+    m.def(
+        "_loo_log_likelihood",
+        py_loo_log_likelihood,
+        "Leave-one-out log-likelihood of the sample for candidate smoothing parameters",
+        py::arg("sample"),
+        py::arg("h_grid"),
+        py::arg("log_likelihood"),
+        py::arg("depends")
+    );
+    m.def(
+        "_rff_update",
+        py_rff_update,
+        "Accumulate random Fourier features of the sample batch",
+        py::arg("sample"),
+        py::arg("omega"),
+        py::arg("offset"),
+        py::arg("h"),
+        py::arg("feature_sums"),
+        py::arg("depends")
+    );
+    m.def(
+        "_rff_evaluate",
+        py_rff_evaluate,
+        "Approximate kernel density estimation from random Fourier features",
+        py::arg("poi"),
+        py::arg("omega"),
+        py::arg("offset"),
+        py::arg("h"),
+        py::arg("feature_sums"),
+        py::arg("n_data"),
+        py::arg("pdf"),
+        py::arg("depends")
+    );
+    m.def(
+        "_kde_accumulate",
+        py_kde_accumulate,
+        "Add, or subtract, unnormalized kernel sums over the sample batch",
+        py::arg("poi"),
+        py::arg("sample"),
+        py::arg("h"),
+        py::arg("sums"),
+        py::arg("sign"),
+        py::arg("kernel"),
+        py::arg("depends")
+    );
+    m.def(
+        "_kde_from_sums",
+        py_kde_from_sums,
+        "Kernel density estimate from unnormalized kernel sums",
+        py::arg("sums"),
+        py::arg("dim"),
+        py::arg("n_data"),
+        py::arg("h"),
+        py::arg("pdf"),
+        py::arg("kernel"),
+        py::arg("depends")
+    );
+    m.def(
+        "_kde_ragged",
+        py_kde_ragged,
+        "Kernel density estimation for a ragged batch of independent groups given by CSR-style offsets",
+        py::arg("poi"),
+        py::arg("poi_offsets"),
+        py::arg("sample"),
+        py::arg("sample_offsets"),
+        py::arg("h"),
+        py::arg("pdf"),
+        py::arg("kernel"),
+        py::arg("depends")
+    );
+    example::telemetry::def_py_functions(m);
+    m.def(
+        "_warmup",
+        py_warmup,
+        "Build device code of the module for the device of the queue",
+        py::arg("sycl_queue")
     );
 }
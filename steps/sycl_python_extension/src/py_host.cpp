@@ -0,0 +1,97 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "kde_host.hpp"
+
+#include <cstdint>
+
+namespace py = pybind11;
+
+typedef std::intptr_t ssize_t;
+
+const auto &unexpected_shape_msg = "Unexpected shapes of array arguments";
+const auto &unexpected_types_msg = "Unexpected types of array arguments: expected arrays of the same real floating type";
+const auto &unexpected_layout_msg = "All input arrays must be C-contiguous";
+const auto &expected_writable_msg = "Output array must be writable";
+
+/*
+    Host implementation of KDE operating on NumPy arrays in place, so that
+    it can be used where SYCL runtime is not available.
+ */
+void
+py_kde_host(
+    const py::array &poi,
+    const py::array &sample,
+    py::object h,
+    py::array &pdf,
+    unsigned int n_threads
+) {
+    if (poi.ndim() != 2 || sample.ndim() != 2 || pdf.ndim() != 1) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    ssize_t m = poi.shape(0);
+    ssize_t d1 = poi.shape(1);
+
+    ssize_t n = sample.shape(0);
+    ssize_t d2 = sample.shape(1);
+
+    ssize_t pdf_len = pdf.shape(0);
+
+    if ((d1 != d2) || (pdf_len != m)) {
+        throw py::value_error(unexpected_shape_msg);
+    }
+
+    if (!poi.dtype().is(sample.dtype()) || !poi.dtype().is(pdf.dtype())) {
+        throw py::value_error(unexpected_types_msg);
+    }
+
+    constexpr auto c_contig = py::array::c_style;
+    if (!(poi.flags() & c_contig) || !(sample.flags() & c_contig) || !(pdf.flags() & c_contig)) {
+        throw py::value_error(unexpected_layout_msg);
+    }
+
+    if (!pdf.writeable()) {
+        throw py::value_error(expected_writable_msg);
+    }
+
+    if (poi.dtype().is(py::dtype::of<float>())) {
+        using T = float;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = static_cast<const T *>(poi.data());
+        const T *sample_ptr = static_cast<const T *>(sample.data());
+        T *pdf_ptr = static_cast<T *>(pdf.mutable_data());
+
+        py::gil_scoped_release release;
+        example::kernel_density_estimate_host<T>(m, d1, poi_ptr, pdf_ptr, n, sample_ptr, h_sc, n_threads);
+
+    } else if (poi.dtype().is(py::dtype::of<double>())) {
+        using T = double;
+
+        T h_sc = py::cast<T>(h);
+        const T *poi_ptr = static_cast<const T *>(poi.data());
+        const T *sample_ptr = static_cast<const T *>(sample.data());
+        T *pdf_ptr = static_cast<T *>(pdf.mutable_data());
+
+        py::gil_scoped_release release;
+        example::kernel_density_estimate_host<T>(m, d1, poi_ptr, pdf_ptr, n, sample_ptr, h_sc, n_threads);
+
+    } else {
+        throw py::value_error(unexpected_types_msg);
+    }
+}
+
+
+PYBIND11_MODULE(_kde_host_ext, m) {
+    m.def(
+        "_kde_host",
+        py_kde_host,
+        "Kernel density estimation on host, for NumPy arrays",
+        py::arg("poi"),
+        py::arg("sample"),
+        py::arg("h"),
+        py::arg("pdf"),
+        py::arg("n_threads") = 0
+    );
+}
@@ -0,0 +1 @@
+../../kernel_density_estimation_cpp/telemetry_pybind.hpp
\ No newline at end of file